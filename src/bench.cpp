@@ -0,0 +1,113 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "bench.h"
+#include "perft.h"
+#include "search.h"
+#include "tt.h"
+
+namespace chess {
+
+    struct BenchPosition{
+        const char* fen;
+        int perft_depth;
+        U64 perft_nodes;
+    };
+
+    /*
+    * Start position, Kiwipete, the positions of test/movegen_tests.json and
+    * a few middlegame and endgame positions, with their known perft counts.
+    */
+    const BenchPosition BENCH_POSITIONS[] = {
+        {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5, 4865609},
+        {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 4085603},
+        {"r6r/1b2k1bq/8/8/7B/8/8/R3K2R b QK - 3 2", 1, 8},
+        {"8/8/8/2k5/2pP4/8/B7/4K3 b - d3 5 3", 1, 8},
+        {"r1bqkbnr/pppppppp/n7/8/8/P7/1PPPPPPP/RNBQKBNR w QqKk - 2 2", 1, 19},
+        {"r3k2r/p1pp1pb1/bn2Qnp1/2qPN3/1p2P3/2N5/PPPBBPPP/R3K2R b QqKk - 3 2", 1, 5},
+        {"2kr3r/p1ppqpb1/bn2Qnp1/3PN3/1p2P3/2N5/PPPBBPPP/R3K2R b QK - 3 2", 1, 44},
+        {"rnb2k1r/pp1Pbppp/2p5/q7/2B5/8/PPPQNnPP/RNB1K2R w QK - 3 9", 1, 39},
+        {"2r5/3pk3/8/2P5/8/2K5/8/8 w - - 5 4", 1, 9},
+        {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 3, 62379},
+        {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 3, 89890},
+        {"3k4/3p4/8/K1P4r/8/8/8/8 b - - 0 1", 6, 1134888},
+        {"8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1", 6, 1015133},
+        {"8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1", 6, 1440467},
+        {"5k2/8/8/8/8/8/8/4K2R w K - 0 1", 6, 661072},
+        {"3k4/8/8/8/8/8/8/R3K3 w Q - 0 1", 6, 803711},
+        {"r3k2r/1b4bq/8/8/8/8/7B/R3K2R w KQkq - 0 1", 4, 1274206},
+        {"r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1", 4, 1720476},
+        {"2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1", 6, 3821001},
+        {"8/8/1P2K3/8/2n5/1q6/8/5k2 b - - 0 1", 5, 1004658},
+        {"4k3/1P6/8/8/8/8/K7/8 w - - 0 1", 6, 217342},
+        {"8/P1k5/K7/8/8/8/8/8 w - - 0 1", 6, 92683},
+        {"K1k5/8/P7/8/8/8/8/8 w - - 0 1", 6, 2217},
+        {"8/k1P5/8/1K6/8/8/8/8 w - - 0 1", 7, 567584},
+        {"8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1", 4, 23527},
+        // middlegames
+        {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4, 422333},
+        {"r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1", 4, 422333},
+        {"r1bqkb1r/pp3ppp/2np1n2/4p3/3NP3/2N5/PPP1BPPP/R1BQK2R w KQkq - 0 7", 4, 2116087},
+        {"r2q1rk1/ppp2ppp/2n1bn2/2bpp3/4P3/2PP1NP1/PP1N1PBP/R1BQ1RK1 w - - 0 8", 4, 1486149},
+        // endgames
+        {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 6, 11030083},
+        {"8/8/8/8/8/8/6k1/4K2R w K - 0 1", 5, 37735},
+        {"8/3k4/3p4/8/3P4/3K4/8/8 w - - 0 1", 6, 157093},
+    };
+
+    /*
+    * Runs every bench position through perft and a fixed depth search.
+    * The signature is the total number of searched nodes : it changes
+    * whenever the search behaviour changes, while perft mismatches point
+    * at move generation regressions.
+    */
+    void bench(int search_depth){
+        U64 perft_nodes = 0;
+        U64 search_nodes = 0;
+        int failures = 0;
+        Position position;
+
+        auto start = std::chrono::steady_clock::now();
+        for(const BenchPosition& bp : BENCH_POSITIONS){
+            position.import_fen(bp.fen);
+            U64 nodes = perft(bp.perft_depth, &position, false);
+            perft_nodes += nodes;
+            if(nodes != bp.perft_nodes){
+                failures++;
+                std::cout << "perft mismatch: " << bp.fen << " depth " << bp.perft_depth
+                          << ": " << nodes << " instead of " << bp.perft_nodes << std::endl;
+            }
+        }
+        auto middle = std::chrono::steady_clock::now();
+        // a fixed size keeps the signature reproducible, the user's size is restored after
+        size_t hash_mb = tt.size();
+        tt.resize(BENCH_HASH_MB);
+        for(const BenchPosition& bp : BENCH_POSITIONS){
+            position.import_fen(bp.fen);
+            tt.clear();
+            search(&position, search_depth);
+            search_nodes += searched_nodes();
+        }
+        auto end = std::chrono::steady_clock::now();
+        tt.resize(hash_mb);
+
+        double perft_time = std::chrono::duration_cast<std::chrono::microseconds>(middle - start).count() / 1000000.0;
+        double search_time = std::chrono::duration_cast<std::chrono::microseconds>(end - middle).count() / 1000000.0;
+        double total_time = perft_time + search_time;
+        U64 total_nodes = perft_nodes + search_nodes;
+        std::cout << std::endl;
+        std::cout << "Positions      : " << sizeof(BENCH_POSITIONS) / sizeof(BenchPosition) << std::endl;
+        std::cout << "Perft nodes    : " << perft_nodes << " in " << perft_time << "s ("
+                  << U64(perft_nodes / perft_time) << " nodes/s)" << std::endl;
+        std::cout << "Perft failures : " << failures << std::endl;
+        std::cout << "Search depth   : " << search_depth << std::endl;
+        std::cout << "Search nodes   : " << search_nodes << " in " << search_time << "s ("
+                  << U64(search_nodes / search_time) << " nodes/s)" << std::endl;
+        std::cout << "Total nodes    : " << total_nodes << std::endl;
+        std::cout << "Total time (s) : " << total_time << std::endl;
+        std::cout << "Nodes/second   : " << U64(total_nodes / total_time) << std::endl;
+        std::cout << "Signature      : " << search_nodes << std::endl;
+    }
+
+}
@@ -0,0 +1,13 @@
+#ifndef BENCH_H_INCLUDED
+#define BENCH_H_INCLUDED
+
+namespace chess {
+
+    const int BENCH_SEARCH_DEPTH = 4;
+    const int BENCH_HASH_MB = 16;
+
+    void bench(int search_depth);
+
+}
+
+#endif // #ifndef BENCH_H_INCLUDED
@@ -0,0 +1,141 @@
+#include "bitboard.h"
+
+namespace chess {
+
+    Magic bishop_magics[64];
+    Magic rook_magics[64];
+
+    U64 pawn_attacks_bb[2][64];
+    U64 knight_attacks_bb[64];
+    U64 king_attacks_bb[64];
+    U64 between_bb[64][64];
+    U64 line_bb[64][64];
+
+    U64 bishop_table[0x1480];  // 5248 entries for all bishop squares
+    U64 rook_table[0x19000];   // 102400 entries for all rook squares
+
+    const int bishop_directions[4][2] = {{1, 1}, {1, -1}, {-1, -1}, {-1, 1}};
+    const int rook_directions[4][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+    const int knight_steps[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+    const int king_steps[8][2] = {{1, 1}, {1, 0}, {1, -1}, {0, -1}, {-1, -1}, {-1, 0}, {-1, 1}, {0, 1}};
+
+    U64 sliding_attacks(const int directions[4][2], int square, U64 occupied){
+        U64 attacks = 0;
+        for(int d = 0; d < 4; d++){
+            int file = square % 8 + directions[d][0];
+            int rank = square / 8 + directions[d][1];
+            while(file >= 0 && file < 8 && rank >= 0 && rank < 8){
+                U64 bit = U64(1) << (file + rank * 8);
+                attacks |= bit;
+                if(occupied & bit){
+                    break;
+                }
+                file += directions[d][0];
+                rank += directions[d][1];
+            }
+        }
+        return attacks;
+    }
+
+    void init_magics(const int directions[4][2], U64* table, Magic magics[]){
+        U64 occupancy[4096];
+        U64 reference[4096];
+#ifndef USE_PEXT
+        const U64 seeds[8] = {728, 10316, 55013, 32803, 12281, 15100, 16645, 255};
+        int epoch[4096] = {0};
+        int current = 0;
+#endif
+
+        for(int square = 0; square < 64; square++){
+            Magic& m = magics[square];
+            int file = square % 8;
+            int rank = square / 8;
+
+            // board edges are not relevant unless the slider stands on them
+            U64 edges = ((U64(0x00000000000000FF) | U64(0xFF00000000000000)) & ~(U64(0xFF) << (rank * 8)))
+                      | ((U64(0x0101010101010101) | U64(0x8080808080808080)) & ~(U64(0x0101010101010101) << file));
+            m.mask = sliding_attacks(directions, square, 0) & ~edges;
+            m.shift = 64 - __builtin_popcountll(m.mask);
+            m.attacks = square == 0 ? table : magics[square - 1].attacks + (1 << (64 - magics[square - 1].shift));
+
+            // enumerate all subsets of the mask (Carry-Rippler trick)
+            int size = 0;
+            U64 b = 0;
+            do {
+                occupancy[size] = b;
+                reference[size] = sliding_attacks(directions, square, b);
+                size++;
+                b = (b - m.mask) & m.mask;
+            } while(b);
+
+#ifdef USE_PEXT
+            for(int i = 0; i < size; i++){
+                m.attacks[m.index(occupancy[i])] = reference[i];
+            }
+#else
+            PRNG rng(seeds[rank]);
+            for(int i = 0; i < size; ){
+                for(m.magic = 0; __builtin_popcountll((m.magic * m.mask) >> 56) < 6; ){
+                    m.magic = rng.sparse_rand();
+                }
+                // epoch avoids clearing the attack table at every failed try
+                for(++current, i = 0; i < size; i++){
+                    unsigned idx = m.index(occupancy[i]);
+                    if(epoch[idx] < current){
+                        epoch[idx] = current;
+                        m.attacks[idx] = reference[i];
+                    } else if(m.attacks[idx] != reference[i]){
+                        break;
+                    }
+                }
+            }
+#endif
+        }
+    }
+
+    U64 step_attacks(const int steps[][2], int nb_steps, int square){
+        U64 attacks = 0;
+        for(int s = 0; s < nb_steps; s++){
+            int file = square % 8 + steps[s][0];
+            int rank = square / 8 + steps[s][1];
+            if(file >= 0 && file < 8 && rank >= 0 && rank < 8){
+                attacks |= U64(1) << (file + rank * 8);
+            }
+        }
+        return attacks;
+    }
+
+    void init_bitboards(){
+        const int white_pawn_steps[2][2] = {{-1, 1}, {1, 1}};
+        const int black_pawn_steps[2][2] = {{-1, -1}, {1, -1}};
+
+        init_magics(bishop_directions, bishop_table, bishop_magics);
+        init_magics(rook_directions, rook_table, rook_magics);
+
+        for(int square = 0; square < 64; square++){
+            pawn_attacks_bb[0][square] = step_attacks(white_pawn_steps, 2, square);
+            pawn_attacks_bb[1][square] = step_attacks(black_pawn_steps, 2, square);
+            knight_attacks_bb[square] = step_attacks(knight_steps, 8, square);
+            king_attacks_bb[square] = step_attacks(king_steps, 8, square);
+        }
+
+        for(int from = 0; from < 64; from++){
+            for(int to = 0; to < 64; to++){
+                U64 to_mask = U64(1) << to;
+                between_bb[from][to] = 0;
+                line_bb[from][to] = 0;
+                if(from == to){
+                    continue;
+                }
+                if(bishop_attacks(from, 0) & to_mask){
+                    between_bb[from][to] = bishop_attacks(from, to_mask) & bishop_attacks(to, U64(1) << from);
+                    line_bb[from][to] = (bishop_attacks(from, 0) & bishop_attacks(to, 0)) | (U64(1) << from) | to_mask;
+                } else if(rook_attacks(from, 0) & to_mask){
+                    between_bb[from][to] = rook_attacks(from, to_mask) & rook_attacks(to, U64(1) << from);
+                    line_bb[from][to] = (rook_attacks(from, 0) & rook_attacks(to, 0)) | (U64(1) << from) | to_mask;
+                }
+            }
+        }
+    }
+
+}
@@ -0,0 +1,90 @@
+#ifndef BITBOARD_H_INCLUDED
+#define BITBOARD_H_INCLUDED
+
+#include <cstdint>
+
+#ifdef USE_PEXT
+#include <immintrin.h>
+#endif
+
+#include "utils.h"
+
+namespace chess {
+
+    /*
+    * Slider attacks are looked up in a shared table : for each square we
+    * keep the relevant occupancy mask (the rays without their last square)
+    * and a magic multiplier mapping every occupancy subset of the mask to
+    * a distinct slot of the square's attack table.
+    *
+    * When built with USE_PEXT (make ARCH=bmi2) the slot is the occupancy
+    * compressed with the BMI2 pext instruction, so no magic is needed.
+    */
+    struct Magic {
+        U64 mask;
+#ifndef USE_PEXT
+        U64 magic;
+#endif
+        U64* attacks;
+        int shift;
+
+        unsigned index(U64 occupied) const {
+#ifdef USE_PEXT
+            return unsigned(_pext_u64(occupied, mask));
+#else
+            return unsigned(((occupied & mask) * magic) >> shift);
+#endif
+        }
+    };
+
+    extern Magic bishop_magics[64];
+    extern Magic rook_magics[64];
+
+    extern U64 pawn_attacks_bb[2][64];
+    extern U64 knight_attacks_bb[64];
+    extern U64 king_attacks_bb[64];
+    extern U64 between_bb[64][64];
+    extern U64 line_bb[64][64];
+
+    void init_bitboards();
+
+    // squares attacked by a pawn of the given color index (0 white, 1 black)
+    inline U64 pawn_attacks(int color, int square){
+        return pawn_attacks_bb[color][square];
+    }
+
+    inline U64 knight_attacks(int square){
+        return knight_attacks_bb[square];
+    }
+
+    inline U64 king_attacks(int square){
+        return king_attacks_bb[square];
+    }
+
+    // squares strictly between two aligned squares, empty if not aligned
+    inline U64 between(int from, int to){
+        return between_bb[from][to];
+    }
+
+    // full line going through two aligned squares, empty if not aligned
+    inline U64 line(int from, int to){
+        return line_bb[from][to];
+    }
+
+    inline U64 bishop_attacks(int square, U64 occupied){
+        const Magic& m = bishop_magics[square];
+        return m.attacks[m.index(occupied)];
+    }
+
+    inline U64 rook_attacks(int square, U64 occupied){
+        const Magic& m = rook_magics[square];
+        return m.attacks[m.index(occupied)];
+    }
+
+    inline U64 queen_attacks(int square, U64 occupied){
+        return bishop_attacks(square, occupied) | rook_attacks(square, occupied);
+    }
+
+}
+
+#endif // #ifndef BITBOARD_H_INCLUDED
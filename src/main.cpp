@@ -1,10 +1,22 @@
 #include "iostream"
+#include "string"
 
+#include "bench.h"
+#include "bitboard.h"
+#include "position.h"
 #include "uci.h"
 
-int main(){
+int main(int argc, char* argv[]){
     std::cout << "Myfish by Julien Durand" << std::endl;
 
+    chess::init_bitboards();
+    chess::Position::init();
+
+    if(argc > 1 && std::string(argv[1]) == "bench"){
+        chess::bench(argc > 2 ? std::stoi(argv[2]) : chess::BENCH_SEARCH_DEPTH);
+        return 0;
+    }
+
     uci::UCIEngine engine;
     engine.run();
 }
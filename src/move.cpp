@@ -1,6 +1,7 @@
 #include <bitset>
 #include <iostream>
 
+#include "bitboard.h"
 #include "move.h"
 
 namespace chess {
@@ -17,30 +18,6 @@ namespace chess {
         }
     }
 
-    U64 perft(int depth, Position* position, bool printinfo){
-        U64 nodes = 0;
-        U64 n_nodes = 0;
-        MoveGenerator generator(position);
-        n_nodes = U64(generator.generate());
-        if(depth == 1 && !printinfo){
-            return n_nodes;
-        }
-        for(Move m : generator.moveList){
-            if(depth > 1){
-                Position new_position(*position);
-                new_position.make_move(&m);
-                n_nodes = perft(depth - 1, &new_position, false);
-            }else{
-                n_nodes = 1;
-            }
-            nodes += n_nodes;
-            if(printinfo){
-                std::cout << m.to_long_algebraic() << ": " << n_nodes << std::endl;
-            }
-        }
-        return nodes;
-    }
-
     /*
     * Move
     */
@@ -100,113 +77,331 @@ namespace chess {
         layer = 0;
         square_mask = ~U64(0);
         seq = 0;
-        own_pieces = position->board.board[turn]
-            | position->board.board[turn + 1]
-            | position->board.board[turn + 2]
-            | position->board.board[turn + 3]
-            | position->board.board[turn + 4]
-            | position->board.board[turn + 5];
-        opponent_pieces = position->board.board[opponent]
-            | position->board.board[opponent + 1]
-            | position->board.board[opponent + 2]
-            | position->board.board[opponent + 3]
-            | position->board.board[opponent + 4]
-            | position->board.board[opponent + 5];
-        all_pieces = own_pieces | opponent_pieces;
+        own_pieces = position->board.color_pieces[turn != 0];
+        opponent_pieces = position->board.color_pieces[turn == 0];
+        all_pieces = position->board.all_pieces;
         free_square = ~all_pieces;
+        if(turn == 0){
+            init_legality<Position::WHITE>();
+        } else {
+            init_legality<Position::BLACK>();
+        }
     }
 
-    int MoveGenerator::generate(){
-        generate_all();
-        for(auto m : allList){
-            if(!ischeck(&m)){
-               moveList.push_back(m);
+    /*
+    * Computes once per position everything needed to only emit legal moves :
+    * the pieces giving check, our pieces pinned against the king, the squares
+    * the king cannot step on, and the squares other pieces must move to when
+    * in single check (capture the checker or block the ray).
+    */
+    template<Color Us>
+    void MoveGenerator::init_legality(){
+        constexpr Color Them = Us == Position::WHITE ? Position::BLACK : Position::WHITE;
+        constexpr int Own = Us == Position::WHITE ? 0 : Board::NB_LAYERS / 2;
+        constexpr int Opp = Board::NB_LAYERS / 2 - Own;
+        const U64* layers = position->board.board;
+
+        U64 king = layers[Own + Board::WHITE_KING_LAYER];
+        if(!king){
+            // no king, as on the empty board before any position command : no legal move at all
+            king_square = NO_KING;
+            checkers = pinned = king_danger = check_mask = 0;
+            return;
+        }
+        king_square = __builtin_ctzll(king);
+
+        // the king does not block the rays of the sliders attacking it
+        king_danger = generate_attacks<Them>(free_square | king);
+
+        U64 diagonal_sliders = layers[Opp + Board::WHITE_BISHOP_LAYER] | layers[Opp + Board::WHITE_QUEEN_LAYER];
+        U64 straight_sliders = layers[Opp + Board::WHITE_ROOK_LAYER] | layers[Opp + Board::WHITE_QUEEN_LAYER];
+        checkers = (pawn_attacks(Us == Position::BLACK, king_square) & layers[Opp + Board::WHITE_PAWN_LAYER])
+                 | (knight_attacks(king_square) & layers[Opp + Board::WHITE_KNIGHT_LAYER])
+                 | (bishop_attacks(king_square, all_pieces) & diagonal_sliders)
+                 | (rook_attacks(king_square, all_pieces) & straight_sliders);
+
+        pinned = 0;
+        U64 snipers = (bishop_attacks(king_square, 0) & diagonal_sliders)
+                    | (rook_attacks(king_square, 0) & straight_sliders);
+        if(snipers) do {
+            U64 blockers = between(king_square, __builtin_ctzll(snipers)) & all_pieces;
+            if(blockers && !(blockers & (blockers - 1))){
+                pinned |= blockers & own_pieces;
             }
+        } while (snipers &= snipers - 1); // reset LS1B
+
+        if(!checkers){
+            check_mask = ~U64(0);
+        } else if(!(checkers & (checkers - 1))){
+            check_mask = checkers | between(king_square, __builtin_ctzll(checkers));
+        } else {
+            check_mask = 0; // double check : only the king can move
         }
-        return moveList.size();
     }
 
-    int MoveGenerator::generate_all(){
-        U64 notOwnPieces = ~own_pieces;
+    U64 MoveGenerator::legal_mask(int from){
+        if(pinned & (U64(1) << from)){
+            return check_mask & line(king_square, from);
+        }
+        return check_mask;
+    }
+
+    int MoveGenerator::generate(){
+        return turn == 0 ? generate<Position::WHITE, ALL>() : generate<Position::BLACK, ALL>();
+    }
+
+    int MoveGenerator::generate_captures(){
+        return turn == 0 ? generate<Position::WHITE, CAPTURES>() : generate<Position::BLACK, CAPTURES>();
+    }
+
+    int MoveGenerator::generate_quiets(){
+        return turn == 0 ? generate<Position::WHITE, QUIETS>() : generate<Position::BLACK, QUIETS>();
+    }
+
+    /*
+    * Appends the legal moves of the given type to moveList : CAPTURES are
+    * the captures, en passant and all promotions, QUIETS the other moves
+    * including castling, ALL both at once.
+    */
+    template<Color Us, MoveGenerator::GenType Type>
+    int MoveGenerator::generate(){
+        constexpr int Own = Us == Position::WHITE ? 0 : Board::NB_LAYERS / 2;
+        U64 targets = Type == CAPTURES ? opponent_pieces : Type == QUIETS ? free_square : ~own_pieces;
         int layer;
         U64 pieces;
         U64 movebits;
-        U64 en_passant_attacks = U64(position->en_passant) << ((position->get_turn() == Position::WHITE) ? 40 : 16);
-        layer = turn + Board::WHITE_PAWN_LAYER;
+
+        if(king_square == NO_KING){
+            return moveList.size();
+        }
+        layer = Own + Board::WHITE_KING_LAYER;
+        movebits = king_attacks(king_square) & targets & ~king_danger;
+        generate_move_bitscan(layer, king_square, layer, movebits);
+
+        if(checkers & (checkers - 1)){
+            return moveList.size(); // double check
+        }
+
+        layer = Own + Board::WHITE_PAWN_LAYER;
         pieces = position->board.board[layer];
         if(pieces) do {
             int from = __builtin_ffsll(pieces) - 1;
             U64 p = U64(1) << from;
-            movebits = generate_pawn_pushes(p, position->get_turn(), free_square);
-            generate_move_bitscan(layer, from, layer, movebits);
-            movebits = generate_pawn_push_promotions(p, position->get_turn(), free_square);
-            if(movebits){
-                generate_move_bitscan(layer, from, layer + Board::WHITE_KNIGHT_LAYER, movebits);
-                generate_move_bitscan(layer, from, layer + Board::WHITE_BISHOP_LAYER, movebits);
-                generate_move_bitscan(layer, from, layer + Board::WHITE_ROOK_LAYER, movebits);
-                generate_move_bitscan(layer, from, layer + Board::WHITE_QUEEN_LAYER, movebits);
+            U64 mask = legal_mask(from);
+            if(Type != CAPTURES){
+                movebits = generate_pawn_pushes<Us>(p, free_square) & mask;
+                generate_move_bitscan(layer, from, layer, movebits);
             }
-            movebits = generate_pawn_double_pushes(p, position->get_turn(), free_square);
-            generate_move_bitscan(layer, from, layer, movebits);
-            movebits = generate_pawn_attacks(p, position->get_turn(), notOwnPieces) & (opponent_pieces | en_passant_attacks);
-            generate_move_bitscan(layer, from, layer, movebits);
-            movebits = generate_pawn_promotion_attacks(p, position->get_turn(), notOwnPieces) & opponent_pieces;
-            if(movebits){
-                generate_move_bitscan(layer, from, layer + Board::WHITE_KNIGHT_LAYER, movebits);
-                generate_move_bitscan(layer, from, layer + Board::WHITE_BISHOP_LAYER, movebits);
-                generate_move_bitscan(layer, from, layer + Board::WHITE_ROOK_LAYER, movebits);
-                generate_move_bitscan(layer, from, layer + Board::WHITE_QUEEN_LAYER, movebits);
+            if(Type != QUIETS){
+                movebits = generate_pawn_push_promotions<Us>(p, free_square) & mask;
+                if(movebits){
+                    generate_move_bitscan(layer, from, layer + Board::WHITE_KNIGHT_LAYER, movebits);
+                    generate_move_bitscan(layer, from, layer + Board::WHITE_BISHOP_LAYER, movebits);
+                    generate_move_bitscan(layer, from, layer + Board::WHITE_ROOK_LAYER, movebits);
+                    generate_move_bitscan(layer, from, layer + Board::WHITE_QUEEN_LAYER, movebits);
+                }
+            }
+            if(Type != CAPTURES){
+                movebits = generate_pawn_double_pushes<Us>(p, free_square) & mask;
+                generate_move_bitscan(layer, from, layer, movebits);
+            }
+            if(Type != QUIETS){
+                movebits = generate_pawn_attacks<Us>(p, opponent_pieces) & mask;
+                generate_move_bitscan(layer, from, layer, movebits);
+                movebits = generate_pawn_promotion_attacks<Us>(p, opponent_pieces) & mask;
+                if(movebits){
+                    generate_move_bitscan(layer, from, layer + Board::WHITE_KNIGHT_LAYER, movebits);
+                    generate_move_bitscan(layer, from, layer + Board::WHITE_BISHOP_LAYER, movebits);
+                    generate_move_bitscan(layer, from, layer + Board::WHITE_ROOK_LAYER, movebits);
+                    generate_move_bitscan(layer, from, layer + Board::WHITE_QUEEN_LAYER, movebits);
+                }
             }
         } while (pieces &= pieces - 1); // reset LS1B
+        if(Type != QUIETS){
+            generate_en_passant<Us>();
+        }
 
-        layer = turn + Board::WHITE_KNIGHT_LAYER;
-        pieces = position->board.board[layer];
+        // pinned knights can never move
+        layer = Own + Board::WHITE_KNIGHT_LAYER;
+        pieces = position->board.board[layer] & ~pinned;
         if(pieces) do {
             int from = __builtin_ffsll(pieces) - 1;
             U64 p = U64(1) << from;
-            movebits = generate_knight_attacks(p, notOwnPieces);
+            movebits = generate_knight_attacks(p, targets) & check_mask;
             generate_move_bitscan(layer, from, layer, movebits);
         } while (pieces &= pieces - 1); // reset LS1B
 
-        layer = turn + Board::WHITE_BISHOP_LAYER;
+        layer = Own + Board::WHITE_BISHOP_LAYER;
         pieces = position->board.board[layer];
         if(pieces) do {
             int from = __builtin_ffsll(pieces) - 1;
             U64 p = U64(1) << from;
-            movebits = generate_bishop_attacks(p, notOwnPieces, free_square);
+            movebits = generate_bishop_attacks(p, targets, free_square) & legal_mask(from);
             generate_move_bitscan(layer, from, layer, movebits);
         } while (pieces &= pieces - 1); // reset LS1B
 
-        layer = turn + Board::WHITE_ROOK_LAYER;
+        layer = Own + Board::WHITE_ROOK_LAYER;
         pieces = position->board.board[layer];
         if(pieces) do {
             int from = __builtin_ffsll(pieces) - 1;
             U64 p = U64(1) << from;
-            movebits = generate_rook_attacks(p, notOwnPieces, free_square);
+            movebits = generate_rook_attacks(p, targets, free_square) & legal_mask(from);
             generate_move_bitscan(layer, from, layer, movebits);
         } while (pieces &= pieces - 1); // reset LS1B
 
-        layer = turn + Board::WHITE_QUEEN_LAYER;
+        layer = Own + Board::WHITE_QUEEN_LAYER;
         pieces = position->board.board[layer];
         if(pieces) do {
             int from = __builtin_ffsll(pieces) - 1;
             U64 p = U64(1) << from;
-            movebits = generate_queen_attacks(p, notOwnPieces, free_square);
+            movebits = generate_queen_attacks(p, targets, free_square) & legal_mask(from);
             generate_move_bitscan(layer, from, layer, movebits);
         } while (pieces &= pieces - 1); // reset LS1B
 
-        layer = turn + Board::WHITE_KING_LAYER;
-        pieces = position->board.board[layer];
+        if(Type != CAPTURES && !checkers){
+            generate_castling<Us>();
+        }
+
+        return moveList.size();
+    }
+
+    bool MoveGenerator::is_legal(Move move){
+        return turn == 0 ? is_legal<Position::WHITE>(move) : is_legal<Position::BLACK>(move);
+    }
+
+    /*
+    * Whether a move coming from elsewhere (transposition table, killers)
+    * is legal here, checked against the same masks as generation uses.
+    */
+    template<Color Us>
+    bool MoveGenerator::is_legal(Move move){
+        constexpr int Own = Us == Position::WHITE ? 0 : Board::NB_LAYERS / 2;
+        constexpr int up = Us == Position::WHITE ? 8 : -8;
+        constexpr U64 last_rank = Us == Position::WHITE ? 0xFF00000000000000 : 0x00000000000000FF;
+        constexpr U64 start_rank = Us == Position::WHITE ? 0x000000000000FF00 : 0x00FF000000000000;
+        int from_layer = move.get_from_layer();
+        int from = move.get_from_square();
+        int to_layer = move.get_to_layer();
+        int to = move.get_to_square();
+        U64 from_mask = U64(1) << from;
+        U64 to_mask = U64(1) << to;
+
+        if(king_square == NO_KING){
+            return false;
+        }
+        if(from_layer < Own || from_layer >= Own + Board::NB_LAYERS / 2
+            || position->board.get_square_layer(from) != from_layer || (to_mask & own_pieces)){
+            return false;
+        }
+        int piece = from_layer - Own;
+
+        if(piece == Board::WHITE_KING_LAYER){
+            if(to_layer != from_layer){
+                return false;
+            }
+            if(king_attacks(from) & to_mask){
+                return !(king_danger & to_mask);
+            }
+            return !checkers && (castling_targets<Us>() & to_mask);
+        }
+        if(checkers & (checkers - 1)){
+            return false; // double check
+        }
+
+        if(piece == Board::WHITE_PAWN_LAYER){
+            bool promotion = to_mask & last_rank;
+            if(promotion ? (to_layer < Own + Board::WHITE_KNIGHT_LAYER || to_layer > Own + Board::WHITE_QUEEN_LAYER)
+                         : to_layer != from_layer){
+                return false;
+            }
+            if(position->en_passant && to == __builtin_ctzll(position->en_passant) + (Us == Position::WHITE ? 40 : 16)){
+                return en_passant_pawns<Us>() & from_mask;
+            }
+            bool reachable = (to == from + up && (to_mask & free_square))
+                || (to == from + 2 * up && (from_mask & start_rank) && (free_square & (U64(1) << (from + up))) && (to_mask & free_square))
+                || (pawn_attacks(Us == Position::BLACK, from) & to_mask & opponent_pieces);
+            return reachable && (legal_mask(from) & to_mask);
+        }
+
+        if(to_layer != from_layer){
+            return false;
+        }
+        U64 attacks = piece == Board::WHITE_KNIGHT_LAYER ? knight_attacks(from)
+                    : piece == Board::WHITE_BISHOP_LAYER ? bishop_attacks(from, all_pieces)
+                    : piece == Board::WHITE_ROOK_LAYER ? rook_attacks(from, all_pieces)
+                    : queen_attacks(from, all_pieces);
+        return (attacks & to_mask) && (legal_mask(from) & to_mask);
+    }
+
+    int MoveGenerator::count_legal(){
+        return turn == 0 ? count_legal<Position::WHITE>() : count_legal<Position::BLACK>();
+    }
+
+    /*
+    * Same moves as generate<Us>() but only popcounts the destination sets,
+    * no Move is ever written. Used at the perft horizon.
+    */
+    template<Color Us>
+    int MoveGenerator::count_legal(){
+        constexpr int Own = Us == Position::WHITE ? 0 : Board::NB_LAYERS / 2;
+        const U64* layers = position->board.board;
+        U64 notOwnPieces = ~own_pieces;
+        U64 pieces;
+        if(king_square == NO_KING){
+            return 0;
+        }
+        int count = __builtin_popcountll(king_attacks(king_square) & notOwnPieces & ~king_danger);
+
+        if(checkers & (checkers - 1)){
+            return count; // double check
+        }
+
+        // pushes of the pawns off the pin lines are counted all at once
+        pieces = layers[Own + Board::WHITE_PAWN_LAYER];
+        U64 free_pawns = pieces & ~pinned;
+        U64 captures = opponent_pieces & check_mask;
+        count += __builtin_popcountll(generate_pawn_pushes<Us>(free_pawns, free_square) & check_mask);
+        count += __builtin_popcountll(generate_pawn_double_pushes<Us>(free_pawns, free_square) & check_mask);
+        count += 4 * __builtin_popcountll(generate_pawn_push_promotions<Us>(free_pawns, free_square) & check_mask);
         if(pieces) do {
-            int from = __builtin_ffsll(pieces) - 1;
+            int from = __builtin_ctzll(pieces);
             U64 p = U64(1) << from;
-            movebits = generate_king_attacks(p, notOwnPieces);
-            generate_move_bitscan(layer, from, layer, movebits);
+            U64 mask = legal_mask(from);
+            if(pinned & p){
+                count += __builtin_popcountll(generate_pawn_pushes<Us>(p, free_square) & mask);
+                count += __builtin_popcountll(generate_pawn_double_pushes<Us>(p, free_square) & mask);
+                count += 4 * __builtin_popcountll(generate_pawn_push_promotions<Us>(p, free_square) & mask);
+            }
+            count += __builtin_popcountll(generate_pawn_attacks<Us>(p, captures & mask));
+            count += 4 * __builtin_popcountll(generate_pawn_promotion_attacks<Us>(p, captures & mask));
+        } while (pieces &= pieces - 1); // reset LS1B
+        if(position->en_passant){
+            count += __builtin_popcountll(en_passant_pawns<Us>());
+        }
+
+        pieces = layers[Own + Board::WHITE_KNIGHT_LAYER] & ~pinned;
+        if(pieces) do {
+            U64 p = pieces & -pieces;
+            count += __builtin_popcountll(generate_knight_attacks(p, notOwnPieces & check_mask));
         } while (pieces &= pieces - 1); // reset LS1B
 
-        generate_castling();
+        pieces = layers[Own + Board::WHITE_BISHOP_LAYER] | layers[Own + Board::WHITE_QUEEN_LAYER];
+        if(pieces) do {
+            int from = __builtin_ctzll(pieces);
+            count += __builtin_popcountll(bishop_attacks(from, all_pieces) & notOwnPieces & legal_mask(from));
+        } while (pieces &= pieces - 1); // reset LS1B
 
-        return allList.size();
+        pieces = layers[Own + Board::WHITE_ROOK_LAYER] | layers[Own + Board::WHITE_QUEEN_LAYER];
+        if(pieces) do {
+            int from = __builtin_ctzll(pieces);
+            count += __builtin_popcountll(rook_attacks(from, all_pieces) & notOwnPieces & legal_mask(from));
+        } while (pieces &= pieces - 1); // reset LS1B
+
+        if(!checkers){
+            count += __builtin_popcountll(castling_targets<Us>());
+        }
+
+        return count;
     }
 
     void MoveGenerator::generate_move_bitscan(int from_layer, int from, int to_layer, U64 bits){
@@ -214,43 +409,70 @@ namespace chess {
             int idx = __builtin_ffsll(bits) - 1;
             Move m;
             m.set(from_layer, from, to_layer, idx);
-            allList.push_back(m);
+            moveList.push_back(m);
         } while (bits &= bits - 1); // reset LS1B
     }
 
-    bool MoveGenerator::ischeck(Move* m){
-        int from_square = m->get_from_square();
-        U64 from = U64(1) << from_square;
-        int from_layer = m->get_from_layer();
-        int to_square = m->get_to_square();
-        U64 to = U64(1) << to_square;
+    template<Color Us>
+    void MoveGenerator::generate_en_passant(){
+        if(!position->en_passant){
+            return;
+        }
+        constexpr int layer = Us == Position::WHITE ? Board::WHITE_PAWN_LAYER : Board::BLACK_PAWN_LAYER;
+        constexpr int ep_rank = Us == Position::WHITE ? 40 : 16;
+        int to = __builtin_ctzll(position->en_passant) + ep_rank;
+        U64 pieces = en_passant_pawns<Us>();
+        if(pieces) do {
+            Move m;
+            m.set(layer, __builtin_ctzll(pieces), layer, to);
+            moveList.push_back(m);
+        } while (pieces &= pieces - 1); // reset LS1B
+    }
 
-        // en passant
-        U64 ep = U64(0);
-        if((from_layer - turn == 0)
-            && (((from_square - to_square) % 8) != 0) // not on the same file
-            && (to & ~opponent_pieces)){
-                ep = (from_layer == Board::WHITE_PAWN_LAYER) ? to >> 8 : to << 8;
+    // pawns that can legally take en passant
+    template<Color Us>
+    U64 MoveGenerator::en_passant_pawns(){
+        constexpr int Own = Us == Position::WHITE ? 0 : Board::NB_LAYERS / 2;
+        constexpr int Opp = Board::NB_LAYERS / 2 - Own;
+        constexpr int ep_rank = Us == Position::WHITE ? 40 : 16;
+        constexpr int up = Us == Position::WHITE ? 8 : -8;
+        const U64* layers = position->board.board;
+        int to = __builtin_ctzll(position->en_passant) + ep_rank;
+        int captured = to - up;
+        U64 to_mask = U64(1) << to;
+        U64 captured_mask = U64(1) << captured;
+
+        // in check, the capture must remove the checker or block its ray
+        if(!(checkers & captured_mask) && !(check_mask & to_mask)){
+            return 0;
         }
-        U64 notOpponentPieces = ~opponent_pieces | to | ep;
-        U64 notOwnPieces = (~own_pieces | from) & ~to;
-        U64 free_square = notOwnPieces & notOpponentPieces;
-        U64 attacks = generate_attacks(to | ep, notOpponentPieces, free_square);
-
-        int king_layer = turn + Board::WHITE_KING_LAYER;
-        U64 ourKing = position->board.board[king_layer] & ~from;
-        ourKing = ourKing | (!ourKing  * to);
-        return attacks & ourKing;
-    }
-
-    U64 MoveGenerator::generate_attacks(U64 to, U64 notOpponentPieces, U64 free_square){
-        int w = position->get_turn() == Position::WHITE ? Position::BLACK : Position::WHITE;
-        U64 attacks = generate_pawn_attacks(position->board.board[opponent + Board::WHITE_PAWN_LAYER] & ~to, w, notOpponentPieces);
-        attacks |= generate_pawn_promotion_attacks(position->board.board[opponent + Board::WHITE_PAWN_LAYER] & ~to, w, notOpponentPieces);
-        attacks |= generate_knight_attacks(position->board.board[opponent + Board::WHITE_KNIGHT_LAYER] & ~to, notOpponentPieces);
-        attacks |= generate_bishop_attacks((position->board.board[opponent + Board::WHITE_BISHOP_LAYER] | position->board.board[opponent + Board::WHITE_QUEEN_LAYER]) & ~to, notOpponentPieces, free_square);
-        attacks |= generate_rook_attacks((position->board.board[opponent + Board::WHITE_ROOK_LAYER] | position->board.board[opponent + Board::WHITE_QUEEN_LAYER]) & ~to, notOpponentPieces, free_square);
-        attacks |= generate_king_attacks(position->board.board[opponent + Board::WHITE_KING_LAYER] & ~to, notOpponentPieces);
+
+        U64 straight_sliders = layers[Opp + Board::WHITE_ROOK_LAYER] | layers[Opp + Board::WHITE_QUEEN_LAYER];
+        U64 diagonal_sliders = layers[Opp + Board::WHITE_BISHOP_LAYER] | layers[Opp + Board::WHITE_QUEEN_LAYER];
+        U64 pieces = pawn_attacks(Us == Position::WHITE, to) & layers[Own + Board::WHITE_PAWN_LAYER];
+        U64 legal = 0;
+        if(pieces) do {
+            U64 from_mask = pieces & -pieces;
+            // both pawns leave the rank at once : look for discovered checks
+            U64 occupied = (all_pieces ^ from_mask ^ captured_mask) | to_mask;
+            if(!(rook_attacks(king_square, occupied) & straight_sliders)
+                && !(bishop_attacks(king_square, occupied) & diagonal_sliders)){
+                    legal |= from_mask;
+            }
+        } while (pieces &= pieces - 1); // reset LS1B
+        return legal;
+    }
+
+    template<Color Them>
+    U64 MoveGenerator::generate_attacks(U64 free_square){
+        constexpr int Opp = Them == Position::WHITE ? 0 : Board::NB_LAYERS / 2;
+        const U64* layers = position->board.board;
+        U64 attacks = generate_pawn_attacks<Them>(layers[Opp + Board::WHITE_PAWN_LAYER], ~U64(0));
+        attacks |= generate_pawn_promotion_attacks<Them>(layers[Opp + Board::WHITE_PAWN_LAYER], ~U64(0));
+        attacks |= generate_knight_attacks(layers[Opp + Board::WHITE_KNIGHT_LAYER], ~U64(0));
+        attacks |= generate_bishop_attacks(layers[Opp + Board::WHITE_BISHOP_LAYER] | layers[Opp + Board::WHITE_QUEEN_LAYER], ~U64(0), free_square);
+        attacks |= generate_rook_attacks(layers[Opp + Board::WHITE_ROOK_LAYER] | layers[Opp + Board::WHITE_QUEEN_LAYER], ~U64(0), free_square);
+        attacks |= generate_king_attacks(layers[Opp + Board::WHITE_KING_LAYER], ~U64(0));
         return attacks;
     }
 
@@ -259,25 +481,26 @@ namespace chess {
     U64 abFileMask = 0xFCFCFCFCFCFCFCFC;
     U64 ghFileMask = 0x3F3F3F3F3F3F3F3F;
 
-    U64 MoveGenerator::generate_pawn_pushes(U64 layer, Color color, U64 free_square){
-        int w = color == Position::WHITE;
-        int b = 1 - w;
-        U64 pushes = layer << (8 * w) | layer >> (8 * b);
-        pushes &= 0x00FFFFFFFFFF0000 * w + 0x0000FFFFFFFFFF00 * b;
-        return pushes & free_square;
+    template<Color Us>
+    U64 MoveGenerator::generate_pawn_pushes(U64 layer, U64 free_square){
+        if(Us == Position::WHITE){
+            return (layer << 8) & 0x00FFFFFFFFFF0000 & free_square;
+        }
+        return (layer >> 8) & 0x0000FFFFFFFFFF00 & free_square;
     }
 
-    U64 MoveGenerator::generate_pawn_push_promotions(U64 layer, Color color, U64 free_square){
-        int w = color == Position::WHITE;
-        int b = 1 - w;
-        U64 pushes = layer << (8 * w) | layer >> (8 * b);
-        pushes &= 0xFF00000000000000 * w + 0x00000000000000FF * b;
-        return pushes & free_square;
+    template<Color Us>
+    U64 MoveGenerator::generate_pawn_push_promotions(U64 layer, U64 free_square){
+        if(Us == Position::WHITE){
+            return (layer << 8) & 0xFF00000000000000 & free_square;
+        }
+        return (layer >> 8) & 0x00000000000000FF & free_square;
     }
 
-    U64 MoveGenerator::generate_pawn_double_pushes(U64 layer, Color color, U64 free_square){
+    template<Color Us>
+    U64 MoveGenerator::generate_pawn_double_pushes(U64 layer, U64 free_square){
         U64 pushes = 0;
-        if(color == Position::WHITE){
+        if(Us == Position::WHITE){
             pushes = (((layer & 0x000000000000FF00) << 8) & free_square) << 8;
         }else{
             pushes = (((layer & 0x00FF000000000000) >> 8) & free_square) >> 8;
@@ -285,9 +508,10 @@ namespace chess {
         return pushes & free_square;
     }
 
-    U64 MoveGenerator::generate_pawn_attacks(U64 layer, Color color, U64 notSelf){
+    template<Color Us>
+    U64 MoveGenerator::generate_pawn_attacks(U64 layer, U64 notSelf){
         U64 attacks = 0;
-        if(color == Position::WHITE){
+        if(Us == Position::WHITE){
             attacks = (layer & aFileMask) << 7
                     | (layer & hFileMask) << 9;
             attacks &= 0x00FFFFFFFFFF0000;
@@ -299,9 +523,10 @@ namespace chess {
         return attacks & notSelf;
     }
 
-    U64 MoveGenerator::generate_pawn_promotion_attacks(U64 layer, Color color, U64 notSelf){
+    template<Color Us>
+    U64 MoveGenerator::generate_pawn_promotion_attacks(U64 layer, U64 notSelf){
         U64 attacks = 0;
-        if(color == Position::WHITE){
+        if(Us == Position::WHITE){
             attacks = (layer & aFileMask) << 7
                     | (layer & hFileMask) << 9;
             attacks &= 0xFF00000000000000;
@@ -326,24 +551,29 @@ namespace chess {
     }
 
     U64 MoveGenerator::generate_bishop_attacks(U64 layer, U64 notSelf, U64 free_square){
-        U64 attacks = expandNE(layer, notSelf, free_square)
-                    | expandSE(layer, notSelf, free_square)
-                    | expandSW(layer, notSelf, free_square)
-                    | expandNW(layer, notSelf, free_square);
-        return attacks;
+        U64 attacks = 0;
+        U64 occupied = ~free_square;
+        if(layer) do {
+            attacks |= bishop_attacks(__builtin_ctzll(layer), occupied);
+        } while (layer &= layer - 1); // reset LS1B
+        return attacks & notSelf;
     }
 
     U64 MoveGenerator::generate_rook_attacks(U64 layer, U64 notSelf, U64 free_square){
-        U64 attacks = expandN(layer, notSelf, free_square)
-                    | expandE(layer, notSelf, free_square)
-                    | expandS(layer, notSelf, free_square)
-                    | expandW(layer, notSelf, free_square);
-        return attacks;
+        U64 attacks = 0;
+        U64 occupied = ~free_square;
+        if(layer) do {
+            attacks |= rook_attacks(__builtin_ctzll(layer), occupied);
+        } while (layer &= layer - 1); // reset LS1B
+        return attacks & notSelf;
     }
 
     U64 MoveGenerator::generate_queen_attacks(U64 layer, U64 notSelf, U64 free_square){
-        U64 attacks = generate_bishop_attacks(layer, notSelf, free_square)
-                    | generate_rook_attacks(layer, notSelf, free_square);
+        U64 attacks = 0;
+        U64 occupied = ~free_square;
+        if(layer) do {
+            attacks |= queen_attacks(__builtin_ctzll(layer), occupied);
+        } while (layer &= layer - 1); // reset LS1B
         return attacks & notSelf;
     }
 
@@ -359,119 +589,34 @@ namespace chess {
         return attacks & notSelf;
     }
 
+    template<Color Us>
     void MoveGenerator::generate_castling(){
-        Move m;
-        int layer = Board::WHITE_KING_LAYER + turn;
-        int b = turn != 0;
-        int from = 4 + 56 * b;
-        int to_kingside = 6 + 56 * b;
-        int to_queenside = 2 + 56 * b;
-        U64 kingside_free_square = U64(0x60) << (56 * b);
-        U64 queenside_free_square = U64(0xE) << (56 * b);
-        U64 kingside_castling_squares = U64(0x70) << (56 * b);
-        U64 queenside_castling_squares = U64(0x1C) << (56 * b);
-
-        U64 free_square = ~own_pieces & ~opponent_pieces;
-        U64 attacks = generate_attacks(U64(0), ~opponent_pieces, free_square);
-        if(position->get_castling(b ? Board::BLACK_KING : Board::WHITE_KING) 
-            && !(attacks & kingside_castling_squares) 
+        constexpr int layer = Us == Position::WHITE ? Board::WHITE_KING_LAYER : Board::BLACK_KING_LAYER;
+        generate_move_bitscan(layer, king_square, layer, castling_targets<Us>());
+    }
+
+    // destination squares of the king for the castlings allowed right now
+    template<Color Us>
+    U64 MoveGenerator::castling_targets(){
+        constexpr bool white = Us == Position::WHITE;
+        constexpr int to_kingside = white ? 6 : 62;
+        constexpr int to_queenside = white ? 2 : 58;
+        constexpr U64 kingside_free_square = U64(0x60) << (white ? 0 : 56);
+        constexpr U64 queenside_free_square = U64(0xE) << (white ? 0 : 56);
+        constexpr U64 kingside_castling_squares = U64(0x60) << (white ? 0 : 56);
+        constexpr U64 queenside_castling_squares = U64(0xC) << (white ? 0 : 56);
+        U64 targets = 0;
+
+        if(position->get_castling(white ? Board::WHITE_KING : Board::BLACK_KING)
+            && !(king_danger & kingside_castling_squares)
             && ((free_square & kingside_free_square) == kingside_free_square)){
-                m.set(layer, from, layer, to_kingside);
-                moveList.push_back(m);
+                targets |= U64(1) << to_kingside;
         }
-        if(position->get_castling(b ? Board::BLACK_QUEEN : Board::WHITE_QUEEN)
-            && !(attacks & queenside_castling_squares) 
+        if(position->get_castling(white ? Board::WHITE_QUEEN : Board::BLACK_QUEEN)
+            && !(king_danger & queenside_castling_squares)
             && ((free_square & queenside_free_square) == queenside_free_square)){
-                m.set(layer, from, layer, to_queenside);
-                moveList.push_back(m);
+                targets |= U64(1) << to_queenside;
         }
-    }
-
-    U64 MoveGenerator::expandN(U64 layer, U64 notSelf, U64 free_square){
-        U64 attacks = layer << 8;
-        attacks |= (attacks & free_square) << 8;
-        attacks |= (attacks & free_square) << 8;
-        attacks |= (attacks & free_square) << 8;
-        attacks |= (attacks & free_square) << 8;
-        attacks |= (attacks & free_square) << 8;
-        attacks |= (attacks & free_square) << 8;
-        return attacks & notSelf;
-    }
-
-    U64 MoveGenerator::expandNE(U64 layer, U64 notSelf, U64 free_square){
-        U64 attacks = (layer & hFileMask) << 9;
-        attacks |= (attacks & free_square & hFileMask) << 9;
-        attacks |= (attacks & free_square & hFileMask) << 9;
-        attacks |= (attacks & free_square & hFileMask) << 9;
-        attacks |= (attacks & free_square & hFileMask) << 9;
-        attacks |= (attacks & free_square & hFileMask) << 9;
-        attacks |= (attacks & free_square & hFileMask) << 9;
-        return attacks & notSelf;
-    }
-
-    U64 MoveGenerator::expandE(U64 layer, U64 notSelf, U64 free_square){
-        U64 attacks = (layer & hFileMask) << 1;
-        attacks |= (attacks & free_square & hFileMask) << 1;
-        attacks |= (attacks & free_square & hFileMask) << 1;
-        attacks |= (attacks & free_square & hFileMask) << 1;
-        attacks |= (attacks & free_square & hFileMask) << 1;
-        attacks |= (attacks & free_square & hFileMask) << 1;
-        attacks |= (attacks & free_square & hFileMask) << 1;
-        return attacks & notSelf;
-    }
-
-    U64 MoveGenerator::expandSE(U64 layer, U64 notSelf, U64 free_square){
-        U64 attacks = (layer & hFileMask) >> 7;
-        attacks |= (attacks & free_square & hFileMask) >> 7;
-        attacks |= (attacks & free_square & hFileMask) >> 7;
-        attacks |= (attacks & free_square & hFileMask) >> 7;
-        attacks |= (attacks & free_square & hFileMask) >> 7;
-        attacks |= (attacks & free_square & hFileMask) >> 7;
-        attacks |= (attacks & free_square & hFileMask) >> 7;
-        return attacks & notSelf;
-    }
-
-    U64 MoveGenerator::expandS(U64 layer, U64 notSelf, U64 free_square){
-        U64 attacks = layer >> 8;
-        attacks |= (attacks & free_square) >> 8;
-        attacks |= (attacks & free_square) >> 8;
-        attacks |= (attacks & free_square) >> 8;
-        attacks |= (attacks & free_square) >> 8;
-        attacks |= (attacks & free_square) >> 8;
-        attacks |= (attacks & free_square) >> 8;
-        return attacks & notSelf;
-    }
-
-    U64 MoveGenerator::expandSW(U64 layer, U64 notSelf, U64 free_square){
-        U64 attacks = (layer & aFileMask) >> 9;
-        attacks |= (attacks & free_square & aFileMask) >> 9;
-        attacks |= (attacks & free_square & aFileMask) >> 9;
-        attacks |= (attacks & free_square & aFileMask) >> 9;
-        attacks |= (attacks & free_square & aFileMask) >> 9;
-        attacks |= (attacks & free_square & aFileMask) >> 9;
-        attacks |= (attacks & free_square & aFileMask) >> 9;
-        return attacks & notSelf;
-    }
-
-    U64 MoveGenerator::expandW(U64 layer, U64 notSelf, U64 free_square){
-        U64 attacks = (layer & aFileMask) >> 1;
-        attacks |= (attacks & free_square & aFileMask) >> 1;
-        attacks |= (attacks & free_square & aFileMask) >> 1;
-        attacks |= (attacks & free_square & aFileMask) >> 1;
-        attacks |= (attacks & free_square & aFileMask) >> 1;
-        attacks |= (attacks & free_square & aFileMask) >> 1;
-        attacks |= (attacks & free_square & aFileMask) >> 1;
-        return attacks & notSelf;
-    }
-
-    U64 MoveGenerator::expandNW(U64 layer, U64 notSelf, U64 free_square){
-        U64 attacks = (layer & aFileMask) << 7;
-        attacks |= (attacks & free_square & aFileMask) << 7;
-        attacks |= (attacks & free_square & aFileMask) << 7;
-        attacks |= (attacks & free_square & aFileMask) << 7;
-        attacks |= (attacks & free_square & aFileMask) << 7;
-        attacks |= (attacks & free_square & aFileMask) << 7;
-        attacks |= (attacks & free_square & aFileMask) << 7;
-        return attacks & notSelf;
+        return targets;
     }
 }
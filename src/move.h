@@ -2,15 +2,12 @@
 #define MOVE_H_INCLUDED
 
 #include <string>
-#include <vector>
 
 #include "position.h"
 #include "utils.h"
 
 namespace chess {
 
-    U64 perft(int depth, Position* position, bool printinfo);
-
     class Move{
     private:
         U8 from_layer;  // 4 bits
@@ -29,10 +26,41 @@ namespace chess {
         U8 get_to_square();
         bool is_promotion();
         std::string to_long_algebraic();
+
+        bool operator==(const Move& m) const {
+            return from_layer == m.from_layer && from_square == m.from_square
+                && to_layer == m.to_layer && to_square == m.to_square;
+        }
+    };
+
+    /*
+    * Fixed capacity move list living on the stack : no position has more
+    * than 218 legal moves, so move generation never needs the heap.
+    */
+    class MoveList{
+    public:
+        static const int MAX_MOVES = 256;
+
+        MoveList() : count(0) {}
+        void push_back(const Move& m) { moves[count++] = m; }
+        void clear() { count = 0; }
+        int size() const { return count; }
+        bool empty() const { return count == 0; }
+        Move& operator[](int i) { return moves[i]; }
+        Move* begin() { return moves; }
+        Move* end() { return moves + count; }
+        const Move* begin() const { return moves; }
+        const Move* end() const { return moves + count; }
+
+    private:
+        Move moves[MAX_MOVES];
+        int count;
     };
 
     class MoveGenerator{
     private:
+        static const int NO_KING = -1;
+
         Position* position;
         int turn;
         int opponent;
@@ -43,36 +71,46 @@ namespace chess {
         U64 opponent_pieces;
         U64 all_pieces;
         U64 free_square;
+        int king_square;
+        U64 checkers;
+        U64 pinned;
+        U64 king_danger;
+        U64 check_mask;
+
+        template<Color Us> void init_legality();
+        U64 legal_mask(int from);
 
     public:
-        std::vector<Move> moveList;
-        std::vector<Move> allList;
+        enum GenType { CAPTURES, QUIETS, ALL };
+
+        MoveList moveList;
 
         MoveGenerator(Position* pos);
         int generate();
-        int generate_all();
-        bool ischeck(Move* m);
-        U64 generate_attacks(U64 to, U64 notOpponentPieces, U64 free_square);
+        int generate_captures();
+        int generate_quiets();
+        template<Color Us, GenType Type> int generate();
+        bool is_legal(Move move);
+        template<Color Us> bool is_legal(Move move);
+        bool in_check() const { return checkers != 0; }
+        int count_legal();
+        template<Color Us> int count_legal();
+        template<Color Them> U64 generate_attacks(U64 free_square);
         void generate_move_bitscan(int from_layer, int from, int to_layer, U64 bits);
-        U64 generate_pawn_pushes(U64 layer, Color color, U64 free_square);
-        U64 generate_pawn_push_promotions(U64 layer, Color color, U64 free_square);
-        U64 generate_pawn_double_pushes(U64 layer, Color color, U64 free_square);
-        U64 generate_pawn_attacks(U64 layer, Color color, U64 notSelf);
-        U64 generate_pawn_promotion_attacks(U64 layer, Color color, U64 notSelf);
+        template<Color Us> U64 generate_pawn_pushes(U64 layer, U64 free_square);
+        template<Color Us> U64 generate_pawn_push_promotions(U64 layer, U64 free_square);
+        template<Color Us> U64 generate_pawn_double_pushes(U64 layer, U64 free_square);
+        template<Color Us> U64 generate_pawn_attacks(U64 layer, U64 notSelf);
+        template<Color Us> U64 generate_pawn_promotion_attacks(U64 layer, U64 notSelf);
         U64 generate_knight_attacks(U64 layer, U64 notSelf);
         U64 generate_bishop_attacks(U64 layer, U64 notSelf, U64 free_square);
         U64 generate_rook_attacks(U64 layer, U64 notSelf, U64 free_square);
         U64 generate_queen_attacks(U64 layer, U64 notSelf, U64 free_square);
         U64 generate_king_attacks(U64 layer, U64 notSelf);
-        void generate_castling();
-        U64 expandN(U64 layer, U64 notSelf, U64 free_square);
-        U64 expandNE(U64 layer, U64 notSelf, U64 free_square);
-        U64 expandE(U64 layer, U64 notSelf, U64 free_square);
-        U64 expandSE(U64 layer, U64 notSelf, U64 free_square);
-        U64 expandS(U64 layer, U64 notSelf, U64 free_square);
-        U64 expandSW(U64 layer, U64 notSelf, U64 free_square);
-        U64 expandW(U64 layer, U64 notSelf, U64 free_square);
-        U64 expandNW(U64 layer, U64 notSelf, U64 free_square);
+        template<Color Us> void generate_en_passant();
+        template<Color Us> U64 en_passant_pawns();
+        template<Color Us> void generate_castling();
+        template<Color Us> U64 castling_targets();
     };
 
 }
@@ -0,0 +1,156 @@
+#include <utility>
+
+#include "movepick.h"
+
+namespace chess {
+
+    void HistoryTable::clear(){
+        for(int c = 0; c < 2; c++){
+            for(int from = 0; from < 64; from++){
+                for(int to = 0; to < 64; to++){
+                    scores[c][from][to] = 0;
+                }
+            }
+        }
+    }
+
+    void HistoryTable::update(int color, Move move, int bonus){
+        int& score = scores[color][move.get_from_square()][move.get_to_square()];
+        score += bonus;
+        if(score >= MAX_SCORE){
+            for(int c = 0; c < 2; c++){
+                for(int from = 0; from < 64; from++){
+                    for(int to = 0; to < 64; to++){
+                        scores[c][from][to] /= 2;
+                    }
+                }
+            }
+        }
+    }
+
+    // a pawn changing file without a piece on the target square takes en passant
+    bool MovePicker::is_capture(Position* position, Move move){
+        int from = move.get_from_square();
+        int to = move.get_to_square();
+        return position->board.get_square_layer(to) != Board::INVALID_LAYER
+            || (move.get_from_layer() % 6 == Board::WHITE_PAWN_LAYER && from % 8 != to % 8);
+    }
+
+    MovePicker::MovePicker(Position* position, Move* tt_move, Move killers[2], HistoryTable* history)
+        : position(position), generator(position), has_tt_move(false), killers(killers),
+          history(history), stage(TT_MOVE), current(0), killer_index(0) {
+        if(tt_move && generator.is_legal(*tt_move)){
+            this->tt_move = *tt_move;
+            has_tt_move = true;
+        }
+    }
+
+    MovePicker::MovePicker(Position* position, bool evasions)
+        : position(position), generator(position), has_tt_move(false), killers(nullptr),
+          history(nullptr), stage(evasions && generator.in_check() ? EVASIONS_INIT : CAPTURES_INIT),
+          current(0), killer_index(0) {
+    }
+
+    // MVV-LVA : most valuable victim first, least valuable attacker first, quiet evasions last
+    void MovePicker::score_captures(){
+        for(int i = current; i < generator.moveList.size(); i++){
+            Move m = generator.moveList[i];
+            int victim = position->board.get_square_layer(m.get_to_square());
+            int victim_value = victim == Board::INVALID_LAYER ? (is_capture(position, m) ? 1 : 0) : PIECE_VALUES[victim % 6];
+            int promotion_value = m.is_promotion() ? PIECE_VALUES[m.get_to_layer() % 6] : 0;
+            scores[i] = (victim_value + promotion_value) * 16 - PIECE_VALUES[m.get_from_layer() % 6];
+        }
+    }
+
+    void MovePicker::score_quiets(){
+        int color = position->get_turn() == Position::WHITE ? 0 : 1;
+        for(int i = current; i < generator.moveList.size(); i++){
+            scores[i] = history->get(color, generator.moveList[i]);
+        }
+    }
+
+    // selection sort step : swaps the best remaining move of the stage to the front
+    bool MovePicker::pick_best(Move& move){
+        int size = generator.moveList.size();
+        while(current < size){
+            int best = current;
+            for(int i = current + 1; i < size; i++){
+                if(scores[i] > scores[best]){
+                    best = i;
+                }
+            }
+            std::swap(generator.moveList[current], generator.moveList[best]);
+            std::swap(scores[current], scores[best]);
+            move = generator.moveList[current++];
+            if(!is_special(move)){
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // moves already yielded by the tt move or killer stages
+    bool MovePicker::is_special(Move move){
+        if(has_tt_move && move == tt_move){
+            return true;
+        }
+        return stage == QUIETS && (move == killers[0] || move == killers[1]);
+    }
+
+    bool MovePicker::next(Move& move){
+        switch(stage){
+        case TT_MOVE:
+            stage = CAPTURES_INIT;
+            if(has_tt_move){
+                move = tt_move;
+                return true;
+            }
+            // fall through
+        case CAPTURES_INIT:
+            generator.generate_captures();
+            score_captures();
+            stage = CAPTURES;
+            // fall through
+        case CAPTURES:
+            if(pick_best(move)){
+                return true;
+            }
+            if(!killers){
+                stage = END;
+                return false;
+            }
+            stage = KILLERS;
+            // fall through
+        case KILLERS:
+            while(killer_index < 2){
+                Move killer = killers[killer_index++];
+                if(!(has_tt_move && killer == tt_move) && !is_capture(position, killer)
+                    && !killer.is_promotion() && generator.is_legal(killer)){
+                    move = killer;
+                    return true;
+                }
+            }
+            stage = QUIETS_INIT;
+            // fall through
+        case QUIETS_INIT:
+            generator.generate_quiets();
+            score_quiets();
+            stage = QUIETS;
+            // fall through
+        case QUIETS:
+            if(pick_best(move)){
+                return true;
+            }
+            stage = END;
+            return false;
+        case EVASIONS_INIT:
+            generator.generate();
+            score_captures();
+            stage = CAPTURES;
+            return next(move);
+        default:
+            return false;
+        }
+    }
+
+}
@@ -0,0 +1,66 @@
+#ifndef MOVEPICK_H_INCLUDED
+#define MOVEPICK_H_INCLUDED
+
+#include "move.h"
+#include "position.h"
+#include "utils.h"
+
+namespace chess {
+
+    /*
+    * Butterfly history : for each side and each from / to squares, how
+    * much the quiet move caused beta cutoffs, weighted by depth. Scores
+    * are halved when one gets too large, so that old cutoffs fade away.
+    */
+    class HistoryTable{
+    public:
+        static const int MAX_SCORE = 1 << 16;
+
+        void clear();
+        void update(int color, Move move, int bonus);
+        int get(int color, Move move) { return scores[color][move.get_from_square()][move.get_to_square()]; }
+
+    private:
+        int scores[2][64][64];
+    };
+
+    /*
+    * Yields the legal moves of a node best first, generating them in
+    * stages so that a node which cuts off early never pays for the later
+    * ones : the transposition table move, then captures and promotions
+    * by MVV-LVA, then the two killer moves of the ply, then the quiet
+    * moves by history score. Within a stage moves are picked lazily by
+    * selection sort. The quiescence picker only yields the captures and
+    * promotions, or every evasion when asked to and in check.
+    */
+    class MovePicker{
+    public:
+        MovePicker(Position* position, Move* tt_move, Move killers[2], HistoryTable* history);
+        MovePicker(Position* position, bool evasions);
+        bool next(Move& move);
+        bool in_check() const { return generator.in_check(); }
+        static bool is_capture(Position* position, Move move);
+
+    private:
+        enum Stage { TT_MOVE, CAPTURES_INIT, CAPTURES, KILLERS, QUIETS_INIT, QUIETS, EVASIONS_INIT, END };
+
+        Position* position;
+        MoveGenerator generator;
+        Move tt_move;
+        bool has_tt_move;
+        Move* killers;
+        HistoryTable* history;
+        int stage;
+        int current;
+        int killer_index;
+        int scores[MoveList::MAX_MOVES];
+
+        void score_captures();
+        void score_quiets();
+        bool pick_best(Move& move);
+        bool is_special(Move move);
+    };
+
+}
+
+#endif // #ifndef MOVEPICK_H_INCLUDED
@@ -0,0 +1,156 @@
+#include <cstdint>
+#include <iostream>
+#include <new>
+
+#include "move.h"
+#include "perft.h"
+#include "scheduler.h"
+
+namespace chess {
+
+    void PerftTable::resize(size_t mb){
+        count = 0;
+        if(mb > 0){
+            // round down to a power of two number of buckets
+            count = 2;
+            // saturate instead of overflowing on absurd sizes
+            size_t bytes = mb > (SIZE_MAX >> 20) ? SIZE_MAX : mb << 20;
+            while(count <= bytes / (2 * sizeof(Entry))){
+                count *= 2;
+            }
+        }
+        // free the old table first, and settle for a smaller one if memory runs out
+        entries.reset();
+        while(count && !(entries.reset(new (std::nothrow) Entry[count]), entries)){
+            count = count > 2 ? count / 2 : 0;
+        }
+        mask = count ? count - 2 : 0;
+        clear();
+    }
+
+    void PerftTable::clear(){
+        for(size_t i = 0; i < count; i++){
+            entries[i].key.store(0, std::memory_order_relaxed);
+            entries[i].data.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    bool PerftTable::probe(U64 key, int depth, U64& nodes){
+        if(!count){
+            return false;
+        }
+        Entry* bucket = &entries[key & mask];
+        for(int i = 0; i < 2; i++){
+            U64 data = bucket[i].data.load(std::memory_order_relaxed);
+            if((bucket[i].key.load(std::memory_order_relaxed) ^ data) == key
+                && int(data & 0xFF) == depth){
+                nodes = data >> 8;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void PerftTable::store(U64 key, int depth, U64 nodes){
+        if(!count){
+            return;
+        }
+        Entry* bucket = &entries[key & mask];
+        U64 stored_depth = bucket[0].data.load(std::memory_order_relaxed) & 0xFF;
+        Entry* e = stored_depth <= U64(depth) ? &bucket[0] : &bucket[1];
+        U64 data = nodes << 8 | U64(depth);
+        e->key.store(key ^ data, std::memory_order_relaxed);
+        e->data.store(data, std::memory_order_relaxed);
+    }
+
+    U64 perft(int depth, Position* position, bool printinfo, PerftTable* table){
+        U64 nodes = 0;
+        U64 n_nodes = 0;
+        if(table && depth > 1 && !printinfo && table->probe(position->key(), depth, nodes)){
+            return nodes;
+        }
+        MoveGenerator generator(position);
+        if(depth == 1 && !printinfo){
+            return U64(generator.count_legal());
+        }
+        generator.generate();
+        for(Move m : generator.moveList){
+            if(depth > 1){
+                StateInfo st;
+                position->make_move(&m, st);
+                n_nodes = perft(depth - 1, position, false, table);
+                position->unmake_move(m, st);
+            }else{
+                n_nodes = 1;
+            }
+            nodes += n_nodes;
+            if(printinfo){
+                std::cout << m.to_long_algebraic() << ": " << n_nodes << std::endl;
+            }
+        }
+        if(table && depth > 1 && !printinfo){
+            table->store(position->key(), depth, nodes);
+        }
+        return nodes;
+    }
+
+    // subtrees of this depth or less are counted by a single task
+    const int PERFT_SPLIT_DEPTH = 3;
+
+    void perft_task(TaskScheduler& scheduler, const Position& position, int depth,
+                    PerftTable* table, std::atomic<U64>* nodes){
+        Position pos(position);
+        if(depth <= PERFT_SPLIT_DEPTH){
+            *nodes += perft(depth, &pos, false, table);
+            return;
+        }
+        MoveGenerator generator(&pos);
+        generator.generate();
+        for(Move m : generator.moveList){
+            StateInfo st;
+            pos.make_move(&m, st);
+            scheduler.spawn([&scheduler, pos, depth, table, nodes](){
+                perft_task(scheduler, pos, depth - 1, table, nodes);
+            });
+            pos.unmake_move(m, st);
+        }
+    }
+
+    /*
+    * Runs perft on a work-stealing thread pool. Every node above the split
+    * depth becomes a task, so idle threads keep stealing subtrees even
+    * when one root move has a much bigger tree than the others. Each root
+    * move accumulates its own counter, which keeps the divide output in
+    * generation order.
+    */
+    U64 parallel_perft(int depth, Position* position, bool printinfo, PerftTable* table, int threads){
+        if(depth < 2 || threads < 2){
+            return perft(depth, position, printinfo, table);
+        }
+        MoveGenerator generator(position);
+        generator.generate();
+        int nb_moves = generator.moveList.size();
+        std::unique_ptr<std::atomic<U64>[]> results(new std::atomic<U64>[nb_moves]);
+
+        TaskScheduler scheduler(threads);
+        for(int i = 0; i < nb_moves; i++){
+            Move m = generator.moveList[i];
+            StateInfo st;
+            results[i] = 0;
+            position->make_move(&m, st);
+            scheduler.spawn(std::bind(perft_task, std::ref(scheduler), *position, depth - 1, table, &results[i]));
+            position->unmake_move(m, st);
+        }
+        scheduler.wait();
+
+        U64 nodes = 0;
+        for(int i = 0; i < nb_moves; i++){
+            nodes += results[i];
+            if(printinfo){
+                std::cout << generator.moveList[i].to_long_algebraic() << ": " << results[i] << std::endl;
+            }
+        }
+        return nodes;
+    }
+
+}
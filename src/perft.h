@@ -0,0 +1,45 @@
+#ifndef PERFT_H_INCLUDED
+#define PERFT_H_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+#include "position.h"
+#include "utils.h"
+
+namespace chess {
+
+    /*
+    * Hash table of perft subtree counts, keyed by position key and depth,
+    * so that transposed subtrees are only counted once. Each bucket holds
+    * a depth-preferred slot and an always-replace slot.
+    *
+    * The table is shared between perft threads without locks : the key is
+    * stored xored with the data, so an entry torn by concurrent writes
+    * simply fails to match on probe.
+    */
+    class PerftTable{
+    public:
+        void resize(size_t mb);
+        void clear();
+        bool probe(U64 key, int depth, U64& nodes);
+        void store(U64 key, int depth, U64 nodes);
+
+    private:
+        struct Entry{
+            std::atomic<U64> key;  // key ^ data
+            std::atomic<U64> data; // nodes << 8 | depth
+        };
+
+        std::unique_ptr<Entry[]> entries;
+        size_t count = 0;
+        size_t mask = 0;
+    };
+
+    U64 perft(int depth, Position* position, bool printinfo, PerftTable* table = nullptr);
+    U64 parallel_perft(int depth, Position* position, bool printinfo, PerftTable* table, int threads);
+
+}
+
+#endif // #ifndef PERFT_H_INCLUDED
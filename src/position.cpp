@@ -1,12 +1,17 @@
+#include <algorithm>
 #include <bitset>
+#include <cassert>
 #include <iostream>
 #include <sstream>
 #include <string>
 
+#include "bitboard.h"
 #include "position.h"
 
 namespace chess {
 
+    const int PIECE_VALUES[6] = {1, 3, 3, 5, 9, 0};
+
     const Piece Board::PIECES[] = {
             Board::WHITE_PAWN, Board::WHITE_KNIGHT, Board::WHITE_BISHOP,
             Board::WHITE_ROOK, Board::WHITE_QUEEN, Board::WHITE_KING,
@@ -14,6 +19,13 @@ namespace chess {
             Board::BLACK_ROOK, Board::BLACK_QUEEN, Board::BLACK_KING
         };
 
+    namespace Zobrist {
+        U64 pieces[Board::NB_LAYERS][64];
+        U64 castling[16];
+        U64 en_passant[8];
+        U64 side;
+    }
+
     Board::Board(){
         empty();
     }
@@ -24,26 +36,46 @@ namespace chess {
 
     void Board::set_square(Piece piece, int square){
         U64 bitmask = get_bitmask(square);
-        for(int layer = 0; layer < NB_LAYERS; layer++){
-            board[layer] &= ~bitmask;
-        }
-        board[get_layer(piece)] |= bitmask;
+        int old_layer = mailbox[square];
+        if(old_layer != INVALID_LAYER){
+            board[old_layer] &= ~bitmask;
+            color_pieces[get_color_index(old_layer)] &= ~bitmask;
+            key ^= Zobrist::pieces[old_layer][square];
+        }
+        int layer = get_layer(piece);
+        mailbox[square] = layer;
+        if(layer != INVALID_LAYER){
+            board[layer] |= bitmask;
+            color_pieces[get_color_index(layer)] |= bitmask;
+            key ^= Zobrist::pieces[layer][square];
+        }
+        all_pieces = color_pieces[0] | color_pieces[1];
     }
 
     Piece Board::get_square(int square){
-        U64 bitmask = get_bitmask(square);
-        for(int l = 0; l < NB_LAYERS; l++){
-            if(board[l] & bitmask){
-                return get_piece(l);
-            }
-        }
-        return EMPTY;
+        int layer = mailbox[square];
+        return layer == INVALID_LAYER ? EMPTY : get_piece(layer);
+    }
+
+    int Board::get_square_layer(int square){
+        return mailbox[square];
     }
 
     void Board::empty(){
         for(int layer = 0; layer < NB_LAYERS; layer++){
             board[layer] = 0;
         }
+        for(int square = 0; square < 64; square++){
+            mailbox[square] = INVALID_LAYER;
+        }
+        color_pieces[0] = 0;
+        color_pieces[1] = 0;
+        all_pieces = 0;
+        key = 0;
+    }
+
+    int Board::get_color_index(int layer){
+        return layer >= NB_LAYERS / 2;
     }
 
     Piece Board::get_piece(int layer){
@@ -98,48 +130,91 @@ namespace chess {
         return file + rank;
     }
 
-    void Board::make_move(Move* move){
+    template<Color Us>
+    int Board::make_move(Move* move){
+        constexpr bool white = Us == Position::WHITE;
+        constexpr int pawn_layer = white ? WHITE_PAWN_LAYER : BLACK_PAWN_LAYER;
+        constexpr int king_layer = white ? WHITE_KING_LAYER : BLACK_KING_LAYER;
+        constexpr int rook_layer = white ? WHITE_ROOK_LAYER : BLACK_ROOK_LAYER;
+        constexpr int opponent = white ? BLACK_PAWN_LAYER : WHITE_PAWN_LAYER;
+        constexpr int king_from = white ? 4 : 60;
+        constexpr int us = white ? 0 : 1;
+        U8 from_layer = move->get_from_layer();
         U8 from_square = move->get_from_square();
         U8 to_layer = move->get_to_layer();
         U8 to_square = move->get_to_square();
         U64 from_mask = U64(1) << from_square;
         U64 to_mask = U64(1) << to_square;
-        U64 take_mask = 0; ;
-        U64 free_squares = ~0;
-        for(int l = 0; l < NB_LAYERS; l++){
-            free_squares &= ~board[l];
-        }
-        if((to_layer == WHITE_PAWN_LAYER) && (to_mask & free_squares)){
-            take_mask = to_mask >> 8; // en passant
-        }
-        if((to_layer == BLACK_PAWN_LAYER) && (to_mask & free_squares)){
-            take_mask = to_mask << 8; // en passant
-        }
-        for(int l = 0; l < NB_LAYERS; l++){
-            board[l] &= ~(from_mask | to_mask | take_mask);
-        }
-        if(to_layer == WHITE_KING_LAYER){
-            if(from_square == 4 && to_square == 6){
-                // white kingside castling
-                board[WHITE_ROOK_LAYER] |= U64(1) << 5;
-                board[WHITE_ROOK_LAYER] &= ~(U64(1) << 7);
-            } else if(from_square == 4 && to_square == 2){
-                // white queenside castling
-                board[WHITE_ROOK_LAYER] |= U64(1) << 3;
-                board[WHITE_ROOK_LAYER] &= ~(U64(1) << 0);
+        int take_square = to_square;
+        int captured_layer = mailbox[to_square];
+        if(captured_layer == INVALID_LAYER && from_layer == pawn_layer
+            && (from_square - to_square) % 8 != 0){
+            // en passant
+            captured_layer = opponent + WHITE_PAWN_LAYER;
+            take_square = white ? to_square - 8 : to_square + 8;
+            mailbox[take_square] = INVALID_LAYER;
+        }
+        if(captured_layer != INVALID_LAYER){
+            board[captured_layer] &= ~(U64(1) << take_square);
+            color_pieces[1 - us] &= ~(U64(1) << take_square);
+            key ^= Zobrist::pieces[captured_layer][take_square];
+        }
+        board[from_layer] &= ~from_mask;
+        board[to_layer] |= to_mask;
+        color_pieces[us] ^= from_mask | to_mask;
+        mailbox[from_square] = INVALID_LAYER;
+        mailbox[to_square] = to_layer;
+        key ^= Zobrist::pieces[from_layer][from_square] ^ Zobrist::pieces[to_layer][to_square];
+        if(to_layer == king_layer && from_square == king_from){
+            if(to_square == king_from + 2){
+                // kingside castling
+                move_rook(rook_layer, king_from + 3, king_from + 1);
+            } else if(to_square == king_from - 2){
+                // queenside castling
+                move_rook(rook_layer, king_from - 4, king_from - 1);
             }
-        } else if(to_layer == BLACK_KING_LAYER){
-            if(from_square == 60 && to_square == 62){
-                // black kingside castling
-                board[BLACK_ROOK_LAYER] |= U64(1) << 61;
-                board[BLACK_ROOK_LAYER] &= ~(U64(1) << 63);
-            } else if(from_square == 60 && to_square == 58){
-                // black queenside castling
-                board[BLACK_ROOK_LAYER] |= U64(1) << 59;
-                board[BLACK_ROOK_LAYER] &= ~(U64(1) << 56);
+        }
+        all_pieces = color_pieces[0] | color_pieces[1];
+        return captured_layer;
+    }
+
+    template<Color Us>
+    void Board::unmake_move(Move* move, int captured_layer, int captured_square){
+        constexpr bool white = Us == Position::WHITE;
+        constexpr int king_layer = white ? WHITE_KING_LAYER : BLACK_KING_LAYER;
+        constexpr int rook_layer = white ? WHITE_ROOK_LAYER : BLACK_ROOK_LAYER;
+        constexpr int king_from = white ? 4 : 60;
+        constexpr int us = white ? 0 : 1;
+        U8 from_square = move->get_from_square();
+        U8 to_square = move->get_to_square();
+        board[move->get_to_layer()] &= ~(U64(1) << to_square);
+        board[move->get_from_layer()] |= U64(1) << from_square;
+        color_pieces[us] ^= (U64(1) << from_square) | (U64(1) << to_square);
+        mailbox[to_square] = INVALID_LAYER;
+        mailbox[from_square] = move->get_from_layer();
+        if(captured_layer != INVALID_LAYER){
+            board[captured_layer] |= U64(1) << captured_square;
+            color_pieces[1 - us] |= U64(1) << captured_square;
+            mailbox[captured_square] = captured_layer;
+        }
+        if(move->get_to_layer() == king_layer && from_square == king_from){
+            if(to_square == king_from + 2){
+                // kingside castling
+                move_rook(rook_layer, king_from + 1, king_from + 3);
+            } else if(to_square == king_from - 2){
+                // queenside castling
+                move_rook(rook_layer, king_from - 1, king_from - 4);
             }
         }
-        board[to_layer] |= to_mask;
+        all_pieces = color_pieces[0] | color_pieces[1];
+    }
+
+    void Board::move_rook(int rook_layer, int from, int to){
+        board[rook_layer] ^= (U64(1) << from) | (U64(1) << to);
+        color_pieces[get_color_index(rook_layer)] ^= (U64(1) << from) | (U64(1) << to);
+        mailbox[from] = INVALID_LAYER;
+        mailbox[to] = rook_layer;
+        key ^= Zobrist::pieces[rook_layer][from] ^ Zobrist::pieces[rook_layer][to];
     }
 
     void Board::print(){
@@ -153,6 +228,51 @@ namespace chess {
         reset();
     }
 
+    void Position::init(){
+        PRNG rng(1070372);
+        for(int layer = 0; layer < Board::NB_LAYERS; layer++){
+            for(int square = 0; square < 64; square++){
+                Zobrist::pieces[layer][square] = rng.rand();
+            }
+        }
+        for(int i = 0; i < 16; i++){
+            Zobrist::castling[i] = rng.rand();
+        }
+        for(int file = 0; file < 8; file++){
+            Zobrist::en_passant[file] = rng.rand();
+        }
+        Zobrist::side = rng.rand();
+    }
+
+    U64 Position::key(){
+        U64 k = board.key ^ Zobrist::castling[castling];
+        if(en_passant){
+            k ^= Zobrist::en_passant[__builtin_ctzll(en_passant)];
+        }
+        if(get_turn() == BLACK){
+            k ^= Zobrist::side;
+        }
+        return k;
+    }
+
+    U64 Position::compute_key(){
+        U64 k = 0;
+        for(int layer = 0; layer < Board::NB_LAYERS; layer++){
+            U64 pieces = board.board[layer];
+            if(pieces) do {
+                k ^= Zobrist::pieces[layer][__builtin_ctzll(pieces)];
+            } while (pieces &= pieces - 1); // reset LS1B
+        }
+        k ^= Zobrist::castling[castling];
+        if(en_passant){
+            k ^= Zobrist::en_passant[__builtin_ctzll(en_passant)];
+        }
+        if(get_turn() == BLACK){
+            k ^= Zobrist::side;
+        }
+        return k;
+    }
+
     void Position::set_start_position(){
         import_fen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
     }
@@ -173,12 +293,14 @@ namespace chess {
                 }
                 fen += piece;
             }
-            if(i % 8 == 7 && i != 63){
+            if(i % 8 == 7){
                 if(nb_empty > 0){
                     fen += std::to_string(nb_empty);
                     nb_empty = 0;
                 }
-                fen += "/";
+                if(i != 63){
+                    fen += "/";
+                }
             }
         }
         return fen + " " + std::string(1, get_turn())
@@ -350,65 +472,110 @@ namespace chess {
     }
 
     void Position::make_move(Move* move){
+        StateInfo st;
+        make_move(move, st);
+    }
+
+    void Position::make_move(Move* move, StateInfo& st){
+        if(get_turn() == WHITE){
+            make_move<WHITE>(move, st);
+        } else {
+            make_move<BLACK>(move, st);
+        }
+    }
+
+    template<Color Us>
+    void Position::make_move(Move* move, StateInfo& st){
+        constexpr bool white = Us == WHITE;
+        constexpr int pawn_layer = white ? Board::WHITE_PAWN_LAYER : Board::BLACK_PAWN_LAYER;
+        constexpr int king_layer = white ? Board::WHITE_KING_LAYER : Board::BLACK_KING_LAYER;
+        constexpr int rook_layer = white ? Board::WHITE_ROOK_LAYER : Board::BLACK_ROOK_LAYER;
+        constexpr U8 kingside_cast = white ? WHITE_KINGSIDE_CAST : BLACK_KINGSIDE_CAST;
+        constexpr U8 queenside_cast = white ? WHITE_QUEENSIDE_CAST : BLACK_QUEENSIDE_CAST;
+        constexpr int up = white ? 8 : -8;
+        st.castling = castling;
+        st.en_passant = en_passant;
+        st.reversible_plies = reversible_plies;
+        st.key = board.key;
+
         plies++;
-        board.make_move(move);
+        st.captured_layer = board.make_move<Us>(move);
         en_passant = 0;
 
+        int from_layer = move->get_from_layer();
+        int from = move->get_from_square();
+        int to = move->get_to_square();
+
         // set rerversible moves
-        if(move->get_from_layer() == Board::WHITE_PAWN_LAYER
-            || move->get_from_layer() == Board::BLACK_PAWN_LAYER){
+        if(from_layer == pawn_layer){
             reversible_plies = 0;
+            // set en passant
+            if(to - from == 2 * up){
+                en_passant = U8(1) << (to % 8);
+            }
         } else{
             // TODO : check attacks (or number of pieces);
             reversible_plies++;
         }
 
-        // set en passant
-        if(move->get_from_layer() == Board::WHITE_PAWN_LAYER
-            && (move->get_to_square() - move->get_from_square() == 16)){
-            en_passant =  U8(1) << ((move->get_to_square() - 8) % 8);
-        }
-        if(move->get_from_layer() == Board::BLACK_PAWN_LAYER
-            && (move->get_to_square() - move->get_from_square() == -16)){
-            en_passant =  U8(1) << ((move->get_to_square() + 8) % 8);
-        }
-
         // set castling rights
-        int from_layer = move->get_from_layer();
-        U64 from = move->get_from_square();
-        U64 to = move->get_to_square();
-        if(from_layer == Board::WHITE_KING_LAYER){
-            set_castling(Board::WHITE_KING, false);
-            set_castling(Board::WHITE_QUEEN, false);
-        } else if(from_layer == Board::BLACK_KING_LAYER){
-            set_castling(Board::BLACK_KING, false);
-            set_castling(Board::BLACK_QUEEN, false);
-        }
-        if(from_layer == Board::WHITE_ROOK_LAYER){
-            if(from == 7){
-                set_castling(Board::WHITE_KING, false);
-            } else if(from == 0){
-                set_castling(Board::WHITE_QUEEN, false);
+        if(castling){
+            if(from_layer == king_layer){
+                castling &= ~(kingside_cast | queenside_cast);
+            } else if(from_layer == rook_layer){
+                if(from == (white ? 7 : 63)){
+                    castling &= ~kingside_cast;
+                } else if(from == (white ? 0 : 56)){
+                    castling &= ~queenside_cast;
+                }
             }
-        } else if(from_layer == Board::BLACK_ROOK_LAYER){
-            if(from == 63){
-                set_castling(Board::BLACK_KING, false);
-            } else if(from == 56){
-                set_castling(Board::BLACK_QUEEN, false);
+            if(to == 7){
+                castling &= ~WHITE_KINGSIDE_CAST;
+            } else if(to == 0){
+                castling &= ~WHITE_QUEENSIDE_CAST;
+            } else if(to == 63){
+                castling &= ~BLACK_KINGSIDE_CAST;
+            } else if(to == 56){
+                castling &= ~BLACK_QUEENSIDE_CAST;
             }
         }
-        if(to == 7){
-            set_castling(Board::WHITE_KING, false);
-        } else if(to == 0){
-            set_castling(Board::WHITE_QUEEN, false);
+#ifdef DEBUG
+        assert(key() == compute_key());
+        U64 occupied = 0;
+        for(int layer = 0; layer < Board::NB_LAYERS; layer++){
+            occupied |= board.board[layer];
         }
-        if(to == 63){
-            set_castling(Board::BLACK_KING, false);
-        } else if(to == 56){
-            set_castling(Board::BLACK_QUEEN, false);
+        assert(board.all_pieces == occupied);
+#endif
+    }
+
+    void Position::unmake_move(Move move, const StateInfo& st){
+        plies--;
+        if(get_turn() == WHITE){
+            unmake_move<WHITE>(move, st);
+        } else {
+            unmake_move<BLACK>(move, st);
         }
     }
 
+    template<Color Us>
+    void Position::unmake_move(Move move, const StateInfo& st){
+        constexpr int pawn_layer = Us == WHITE ? Board::WHITE_PAWN_LAYER : Board::BLACK_PAWN_LAYER;
+        constexpr int ep_rank = Us == WHITE ? 40 : 16;
+        constexpr int up = Us == WHITE ? 8 : -8;
+        int to = move.get_to_square();
+        int captured_square = to;
+        if(move.get_from_layer() == pawn_layer && st.en_passant
+            && to == __builtin_ctzll(st.en_passant) + ep_rank){
+            captured_square = to - up;
+        }
+        board.unmake_move<Us>(&move, st.captured_layer, captured_square);
+        board.key = st.key;
+        castling = st.castling;
+        en_passant = st.en_passant;
+        reversible_plies = st.reversible_plies;
+    }
+
     Move Position::get_move_from_long_algebraic(const std::string &m){
         int from = Board::coordinates_to_square(m.substr(0, 2));
         int to = Board::coordinates_to_square(m.substr(2, 4));
@@ -444,4 +611,97 @@ namespace chess {
         }
         return Move();
     }
+
+    // pieces of both colors attacking the square, sliders seeing through the empty squares of occupied
+    U64 Position::attackers_to(int square, U64 occupied){
+        const U64* layers = board.board;
+        return (pawn_attacks(1, square) & layers[Board::WHITE_PAWN_LAYER])
+             | (pawn_attacks(0, square) & layers[Board::BLACK_PAWN_LAYER])
+             | (knight_attacks(square) & (layers[Board::WHITE_KNIGHT_LAYER] | layers[Board::BLACK_KNIGHT_LAYER]))
+             | (king_attacks(square) & (layers[Board::WHITE_KING_LAYER] | layers[Board::BLACK_KING_LAYER]))
+             | (bishop_attacks(square, occupied) & (layers[Board::WHITE_BISHOP_LAYER] | layers[Board::BLACK_BISHOP_LAYER]
+                                                  | layers[Board::WHITE_QUEEN_LAYER] | layers[Board::BLACK_QUEEN_LAYER]))
+             | (rook_attacks(square, occupied) & (layers[Board::WHITE_ROOK_LAYER] | layers[Board::BLACK_ROOK_LAYER]
+                                                | layers[Board::WHITE_QUEEN_LAYER] | layers[Board::BLACK_QUEEN_LAYER]));
+    }
+
+    /*
+    * Static exchange evaluation : the material won by the side to move,
+    * in pawns, if both sides keep capturing on the target square of the
+    * move with their least valuable attacker, each side being free to stop
+    * when going on would lose material. Sliders hidden behind a capturer
+    * join the exchange once it has left (x-rays). Pins are not taken into
+    * account, and the king only captures when the square is no longer
+    * defended.
+    */
+    int Position::see(Move move){
+        const U64* layers = board.board;
+        int from = move.get_from_square();
+        int to = move.get_to_square();
+        int victim = board.get_square_layer(to);
+        int side = Board::get_color_index(move.get_from_layer());
+        U64 occupied = board.all_pieces ^ (U64(1) << from);
+
+        int gain[32];
+        gain[0] = victim == Board::INVALID_LAYER ? 0 : PIECE_VALUES[victim % 6];
+        if(move.get_from_layer() % 6 == Board::WHITE_PAWN_LAYER && victim == Board::INVALID_LAYER && from % 8 != to % 8){
+            // en passant : the captured pawn stands behind the target square
+            gain[0] = PIECE_VALUES[Board::WHITE_PAWN_LAYER];
+            occupied ^= U64(1) << (side == 0 ? to - 8 : to + 8);
+        }
+        if(move.is_promotion()){
+            gain[0] += PIECE_VALUES[move.get_to_layer() % 6] - PIECE_VALUES[Board::WHITE_PAWN_LAYER];
+        }
+        int on_square = PIECE_VALUES[move.get_to_layer() % 6];
+
+        U64 diagonal_sliders = layers[Board::WHITE_BISHOP_LAYER] | layers[Board::BLACK_BISHOP_LAYER]
+                             | layers[Board::WHITE_QUEEN_LAYER] | layers[Board::BLACK_QUEEN_LAYER];
+        U64 straight_sliders = layers[Board::WHITE_ROOK_LAYER] | layers[Board::BLACK_ROOK_LAYER]
+                             | layers[Board::WHITE_QUEEN_LAYER] | layers[Board::BLACK_QUEEN_LAYER];
+        U64 attackers = attackers_to(to, occupied) & occupied;
+        int depth = 0;
+        while(true){
+            side ^= 1;
+            U64 own_attackers = attackers & board.color_pieces[side];
+            if(!own_attackers){
+                break;
+            }
+            int layer = side * Board::NB_LAYERS / 2;
+            while(!(own_attackers & layers[layer])){
+                layer++;
+            }
+            if(layer % 6 == Board::WHITE_KING_LAYER && (attackers & board.color_pieces[side ^ 1])){
+                break;
+            }
+            depth++;
+            gain[depth] = on_square - gain[depth - 1];
+            on_square = PIECE_VALUES[layer % 6];
+            U64 attacker = own_attackers & layers[layer];
+            occupied ^= attacker & -attacker;
+            // reveal the sliders standing behind the capturer
+            attackers |= (bishop_attacks(to, occupied) & diagonal_sliders) | (rook_attacks(to, occupied) & straight_sliders);
+            attackers &= occupied;
+        }
+        while(depth > 0){
+            gain[depth - 1] = -std::max(-gain[depth - 1], gain[depth]);
+            depth--;
+        }
+        return gain[0];
+    }
+
+    bool Position::see_ge(Move move, int threshold){
+        if(!move.is_promotion()){
+            int victim = board.get_square_layer(move.get_to_square());
+            int victim_value = victim == Board::INVALID_LAYER ? 0 : PIECE_VALUES[victim % 6];
+            // winning the capture for free, a pawn at most for en passant
+            if(std::max(victim_value, PIECE_VALUES[Board::WHITE_PAWN_LAYER]) < threshold){
+                return false;
+            }
+            // losing the capturer right back
+            if(victim_value - PIECE_VALUES[move.get_from_layer() % 6] >= threshold){
+                return true;
+            }
+        }
+        return see(move) >= threshold;
+    }
 }
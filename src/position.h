@@ -8,6 +8,9 @@
 
 namespace chess{
 
+    // piece values indexed by layer % 6 : pawn, knight, bishop, rook, queen, king
+    extern const int PIECE_VALUES[6];
+
     class Board{
     public:
         static const Piece EMPTY = ' ';
@@ -43,20 +46,40 @@ namespace chess{
         static const Piece PIECES[12];
 
         U64 board[NB_LAYERS];
+        U64 color_pieces[2]; // occupancy of white (0) and black (1)
+        U64 all_pieces;
+        int8_t mailbox[64]; // layer of the piece on each square
+        U64 key; // Zobrist hash of the piece layers
 
         Board();
         void set_square(Piece piece, int square);
         Piece get_square(int square);
+        int get_square_layer(int square);
         void empty();
         static Piece get_piece(int layer);
+        static int get_color_index(int layer);
         static int get_layer(Piece piece);
         static int coordinates_to_square(std::string coordinates);
         static std::string square_to_coordinate(int square);
-        void make_move(Move* move);
+        template<Color Us> int make_move(Move* move);
+        template<Color Us> void unmake_move(Move* move, int captured_layer, int captured_square);
         void print();
 
     private:
         U64 get_bitmask(int square);
+        void move_rook(int rook_layer, int from, int to);
+    };
+
+    /*
+    * What make_move cannot recompute when the move is taken back. Callers
+    * keep one StateInfo per ply, so the search stack is the undo stack.
+    */
+    struct StateInfo{
+        U8 castling;
+        U8 en_passant;
+        int reversible_plies;
+        int captured_layer;
+        U64 key;
     };
 
     class Position{
@@ -80,6 +103,9 @@ namespace chess{
         static const Color BLACK = 'b';
 
         Position();
+        static void init();
+        U64 key();
+        U64 compute_key();
         void set_start_position();
         std::string export_fen();
         void import_fen(const std::string &fen);
@@ -96,7 +122,14 @@ namespace chess{
         std::string get_square(int square);
         void reset();
         void make_move(Move* move);
+        void make_move(Move* move, StateInfo& st);
+        template<Color Us> void make_move(Move* move, StateInfo& st);
+        void unmake_move(Move move, const StateInfo& st);
+        template<Color Us> void unmake_move(Move move, const StateInfo& st);
         Move get_move_from_long_algebraic(const std::string &m);
+        U64 attackers_to(int square, U64 occupied);
+        int see(Move move);
+        bool see_ge(Move move, int threshold);
     };
 
 }
@@ -0,0 +1,101 @@
+#include "scheduler.h"
+
+namespace chess {
+
+    // pool owning this thread and index of its worker, nullptr and -1 outside any pool
+    thread_local TaskScheduler* worker_pool = nullptr;
+    thread_local int worker_id = -1;
+
+    TaskScheduler::TaskScheduler(int threads) : pending(0), queued(0), next_queue(0), stopping(false){
+        threads = threads < 1 ? 1 : threads;
+        for(int i = 0; i < threads; i++){
+            queues.emplace_back(new WorkQueue());
+        }
+        for(int i = 0; i < threads; i++){
+            workers.emplace_back(&TaskScheduler::work, this, i);
+        }
+    }
+
+    TaskScheduler::~TaskScheduler(){
+        wait();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        work_available.notify_all();
+        for(std::thread& worker : workers){
+            worker.join();
+        }
+    }
+
+    int TaskScheduler::size(){
+        return workers.size();
+    }
+
+    void TaskScheduler::spawn(Task task){
+        // tasks spawned from outside the pool, including from another pool, are dealt round robin
+        int id = worker_pool == this ? worker_id : next_queue++ % queues.size();
+        pending++;
+        {
+            std::lock_guard<std::mutex> lock(queues[id]->mutex);
+            queues[id]->tasks.push_back(std::move(task));
+        }
+        queued++;
+        std::lock_guard<std::mutex> lock(mutex);
+        work_available.notify_one();
+    }
+
+    void TaskScheduler::wait(){
+        std::unique_lock<std::mutex> lock(mutex);
+        all_done.wait(lock, [this]{ return pending == 0; });
+    }
+
+    bool TaskScheduler::pop(int id, Task& task){
+        std::lock_guard<std::mutex> lock(queues[id]->mutex);
+        if(queues[id]->tasks.empty()){
+            return false;
+        }
+        task = std::move(queues[id]->tasks.back());
+        queues[id]->tasks.pop_back();
+        queued--;
+        return true;
+    }
+
+    bool TaskScheduler::steal(int id, Task& task){
+        int n = queues.size();
+        for(int i = 1; i < n; i++){
+            WorkQueue& victim = *queues[(id + i) % n];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if(!victim.tasks.empty()){
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                queued--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void TaskScheduler::work(int id){
+        worker_pool = this;
+        worker_id = id;
+        for(;;){
+            Task task;
+            if(pop(id, task) || steal(id, task)){
+                task();
+                if(--pending == 0){
+                    std::lock_guard<std::mutex> lock(mutex);
+                    all_done.notify_all();
+                }
+                continue;
+            }
+            // sleep until a task is spawned, running tasks may still spawn work to steal
+            std::unique_lock<std::mutex> lock(mutex);
+            work_available.wait(lock, [this]{ return stopping || queued > 0; });
+            if(stopping){
+                return;
+            }
+        }
+    }
+
+}
@@ -0,0 +1,57 @@
+#ifndef SCHEDULER_H_INCLUDED
+#define SCHEDULER_H_INCLUDED
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace chess {
+
+    /*
+    * Work-stealing task scheduler. Every worker owns a deque : it pushes
+    * and pops its own tasks at the back (depth first), while idle workers
+    * steal from the front of the others' deques, where the oldest and
+    * therefore biggest subtrees are waiting.
+    *
+    * Tasks may spawn new tasks; wait() returns once every task, including
+    * the spawned ones, has completed.
+    */
+    class TaskScheduler{
+    public:
+        typedef std::function<void()> Task;
+
+        TaskScheduler(int threads);
+        ~TaskScheduler();
+        void spawn(Task task);
+        void wait();
+        int size();
+
+    private:
+        struct WorkQueue{
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        std::vector<std::unique_ptr<WorkQueue>> queues;
+        std::vector<std::thread> workers;
+        std::atomic<int> pending; // spawned and not completed yet
+        std::atomic<int> queued;  // spawned and not started yet
+        std::atomic<unsigned> next_queue;
+        std::atomic<bool> stopping;
+        std::mutex mutex;
+        std::condition_variable work_available;
+        std::condition_variable all_done;
+
+        void work(int id);
+        bool pop(int id, Task& task);
+        bool steal(int id, Task& task);
+    };
+
+}
+
+#endif // #ifndef SCHEDULER_H_INCLUDED
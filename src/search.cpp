@@ -1,10 +1,110 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
 #include <utility> 
+#include <vector>
 
+#include "movepick.h"
 #include "search.h"
+#include "timeman.h"
+#include "tt.h"
 
 namespace chess {
 
+	const int CHECK_LIMITS_INTERVAL = 1024;
+	// being mated at ply p scores -MATE_VALUE + p, so that shorter mates score higher
+	const double MATE_VALUE = 10000;
+	const double MATE_IN_MAX_PLY = MATE_VALUE - 2 * MAX_PLY;
+	const double INFINITE_VALUE = 10000000;
+	// scores are in pawns, a null window is one centipawn wide
+	const double NULL_WINDOW = 0.01;
+	const int ASPIRATION_DEPTH = 4;
+	const double ASPIRATION_DELTA = 0.5;
+	// the most a quiet position can change beyond the captured material, in pawns
+	const double DELTA_MARGIN = 2;
+
+	/*
+	* One search thread of the Lazy SMP search : every thread runs the same
+	* iterative deepening on its own copy of the position, and they only
+	* cooperate through the shared transposition table. Helper threads
+	* (id > 0) keep the root moves rotated by their id, and odd helpers
+	* always search one ply deeper than the main thread's current
+	* iteration, so that they do not all walk the same tree.
+	* Only the main thread (id 0) checks the limits, prints and decides the
+	* best move. Killers and history are kept per thread.
+	*/
+	class SearchThread{
+	public:
+		SearchThread(int id, const Position& position);
+		void iterate();
+
+		int id;
+		Position position;
+		std::atomic<U64> nodes;
+		Move best_move;
+
+	private:
+		Move killers[MAX_PLY + 1][2];
+		HistoryTable history;
+
+		void count_node();
+		void update_quiet_stats(Move move, int ply, int depth);
+		double quiesce(double alpha, double beta, int ply, int qply);
+		double alphabeta(double alpha, double beta, int depth, int ply);
+		double search_child(double alpha, double beta, int depth, int ply, bool first);
+		double search_root(MoveList& moves, double alpha, double beta, int depth, Move& root_best);
+	};
+
+	SearchLimits limits;
+	TimeManager time_manager;
+	bool print_info = true;
+	std::atomic<bool> stopped(false);
+	std::atomic<bool> pondering(false);
+	std::vector<SearchThread*> search_threads;
+	std::atomic<int> main_depth(1);
+	U64 nodes = 0;
+
+	void init_search(bool ponder){
+		stopped = false;
+		pondering = ponder;
+	}
+
+	void stop_search(){
+		stopped = true;
+	}
+
+	void ponderhit(){
+		pondering = false;
+	}
+
+	U64 searched_nodes(){
+		return nodes;
+	}
+
+	U64 total_nodes(){
+		U64 total = 0;
+		for(SearchThread* thread : search_threads){
+			total += thread->nodes.load(std::memory_order_relaxed);
+		}
+		return total;
+	}
+
+	// called by the main thread every CHECK_LIMITS_INTERVAL nodes to stop on the deadline or node budget
+	void check_limits(){
+		if(pondering){
+			return;
+		}
+		if((time_manager.maximum() && time_manager.elapsed() >= time_manager.maximum())
+			|| (limits.nodes && total_nodes() >= limits.nodes)){
+			stopped = true;
+		}
+	}
+
 	double eval(Position* position){
 		float score = 0;
 		score += __builtin_popcountl(position->board.board[Board::WHITE_PAWN_LAYER]) * 1;
@@ -22,65 +122,371 @@ namespace chess {
         return score;
 	}
 
-    double quiesce(double alpha, double beta, Position* position){
-        double stand_pat = eval(position) * (position->get_turn() == Position::WHITE ? 1 : -1); 
-        if(stand_pat >= beta){
-            return beta;
-        }
-        if(alpha < stand_pat){
-            alpha = stand_pat;
-        }
-        /*until(){
-            if(score >= beta){
-                return beta;
-            }
-            if(score > alpha){
-               alpha = score;
-            }
-        }*/
-        return alpha;
-    }
-
-	double alphabeta(double alpha, double beta, Position* position, int depth){
+	// the table stores mate scores relative to the node, not to the root
+	double score_to_tt(double score, int ply){
+		return score >= MATE_IN_MAX_PLY ? score + ply : score <= -MATE_IN_MAX_PLY ? score - ply : score;
+	}
+
+	double score_from_tt(double score, int ply){
+		return score >= MATE_IN_MAX_PLY ? score - ply : score <= -MATE_IN_MAX_PLY ? score + ply : score;
+	}
+
+	// UCI score : centipawns, or moves to mate, negative when getting mated
+	std::string uci_score(double value){
+		if(std::abs(value) >= MATE_IN_MAX_PLY){
+			int plies = int(std::lround(MATE_VALUE - std::abs(value)));
+			return "mate " + std::to_string(value > 0 ? (plies + 1) / 2 : -(plies / 2));
+		}
+		return "cp " + std::to_string(int(value * 100));
+	}
+
+	SearchThread::SearchThread(int id, const Position& position) : id(id), position(position), nodes(0) {
+		for(int ply = 0; ply <= MAX_PLY; ply++){
+			killers[ply][0].set(0, 0, 0, 0);
+			killers[ply][1].set(0, 0, 0, 0);
+		}
+		history.clear();
+	}
+
+	// a quiet move caused a beta cutoff : remember it as a killer and in the history
+	void SearchThread::update_quiet_stats(Move move, int ply, int depth){
+		if(!(killers[ply][0] == move)){
+			killers[ply][1] = killers[ply][0];
+			killers[ply][0] = move;
+		}
+		history.update(position.get_turn() == Position::WHITE ? 0 : 1, move, depth * depth);
+	}
+
+	// only the owner thread writes its counter, no need for an atomic increment
+	void SearchThread::count_node(){
+		U64 n = nodes.load(std::memory_order_relaxed) + 1;
+		nodes.store(n, std::memory_order_relaxed);
+		if(id == 0 && n % CHECK_LIMITS_INTERVAL == 0){
+			check_limits();
+		}
+	}
+
+	/*
+	* Quiescence search : resolves the captures and promotions left at the
+	* horizon so that positions are not scored in the middle of an
+	* exchange. The side to move may stand pat on the static eval, except
+	* when in check at the first quiescence ply, where all evasions are
+	* searched instead. Deeper checks are not resolved, so that the tree
+	* stays small. Captures that cannot bring the score back to alpha
+	* even with a DELTA_MARGIN to spare are pruned (delta pruning), and so
+	* are captures losing material in the exchange on their square.
+	*/
+	double SearchThread::quiesce(double alpha, double beta, int ply, int qply){
+		Position* position = &this->position;
+		count_node();
+		if(stopped){
+			return 0;
+		}
+
+		double stand_pat = eval(position) * (position->get_turn() == Position::WHITE ? 1 : -1);
+		// beyond the first ply checks are ignored : stand pat before paying for the move picker
+		if(qply > 0 && (stand_pat >= beta || ply >= MAX_PLY)){
+			return stand_pat;
+		}
+
+		MovePicker picker(position, qply == 0);
+		bool evading = qply == 0 && picker.in_check();
+		double value = -MATE_VALUE + ply;
+		if(!evading){
+			if(stand_pat >= beta || ply >= MAX_PLY){
+				return stand_pat;
+			}
+			value = stand_pat;
+			alpha = std::max(alpha, stand_pat);
+		}
+
+		Move m;
+		while(picker.next(m)){
+			if(!evading && !m.is_promotion()){
+				int victim = position->board.get_square_layer(m.get_to_square());
+				double gain = victim == Board::INVALID_LAYER ? PIECE_VALUES[0] : PIECE_VALUES[victim % 6];
+				if(stand_pat + gain + DELTA_MARGIN <= alpha){
+					continue;
+				}
+			}
+			if(!evading && !position->see_ge(m, 0)){
+				continue;
+			}
+			StateInfo st;
+			position->make_move(&m, st);
+			double score = -quiesce(-beta, -alpha, ply + 1, qply + 1);
+			position->unmake_move(m, st);
+			if(stopped){
+				return 0;
+			}
+			if(score > value){
+				value = score;
+				alpha = std::max(value, alpha);
+				if(alpha >= beta){
+					break;  // cut-off
+				}
+			}
+		}
+		return value;
+	}
+
+	/*
+	* Principal variation search of the move just made : the first move of
+	* a node gets the full window, the others are expected to fail low and
+	* are only proven worse than alpha with a null window. Those which fail
+	* high inside the window are searched again with the full window.
+	*/
+	double SearchThread::search_child(double alpha, double beta, int depth, int ply, bool first){
+		if(first){
+			return -alphabeta(-beta, -alpha, depth - 1, ply + 1);
+		}
+		double score = -alphabeta(-alpha - NULL_WINDOW, -alpha, depth - 1, ply + 1);
+		if(score > alpha && score < beta && !stopped){
+			score = -alphabeta(-beta, -alpha, depth - 1, ply + 1);
+		}
+		return score;
+	}
+
+	double SearchThread::alphabeta(double alpha, double beta, int depth, int ply){
+		Position* position = &this->position;
 		if(depth == 0){
-			return quiesce(alpha, beta, position); 
+			return quiesce(alpha, beta, ply, 0);
+		}
+		count_node();
+		if(stopped){
+			return 0;
 		}
 
-		MoveGenerator generator(position);
-		generator.generate();
-		double value = -10000;
-		for(Move m : generator.moveList){
-        	Position new_position(*position);
-        	new_position.make_move(&m);
-        	value = std::max(value, -alphabeta(-beta, -alpha, &new_position, depth - 1));
+		U64 key = position->key();
+		TTEntry entry;
+		bool tt_hit = tt.probe(key, entry);
+		if(tt_hit && entry.depth >= depth){
+			double tt_score = score_from_tt(entry.score, ply);
+			if(entry.bound == BOUND_EXACT
+				|| (entry.bound == BOUND_LOWER && tt_score >= beta)
+				|| (entry.bound == BOUND_UPPER && tt_score <= alpha)){
+				return tt_score;
+			}
+		}
+
+		MovePicker picker(position, tt_hit && entry.has_move ? &entry.move : nullptr, killers[ply], &history);
+		double alpha_orig = alpha;
+		double value = -MATE_VALUE + ply;
+		Move best_move;
+		bool has_best_move = false;
+		Move m;
+		bool first = true;
+		while(picker.next(m)){
+        	StateInfo st;
+        	position->make_move(&m, st);
+        	double score = search_child(alpha, beta, depth, ply, first);
+        	position->unmake_move(m, st);
+        	first = false;
+        	if(stopped){
+        		return 0;
+        	}
+        	if(score > value){
+        		value = score;
+        		if(score > alpha_orig){
+        			best_move = m;
+        			has_best_move = true;
+        		}
+        	}
         	alpha = std::max(value, alpha);
         	if(alpha >= beta){
+        		if(!MovePicker::is_capture(position, m) && !m.is_promotion()){
+        			update_quiet_stats(m, ply, depth);
+        		}
         		break;  // cut-off
         	}
         }
+        if(first && !picker.in_check()){
+        	value = 0; // stalemate
+        }
+
+        Bound bound = value >= beta ? BOUND_LOWER : value > alpha_orig ? BOUND_EXACT : BOUND_UPPER;
+        tt.store(key, score_to_tt(value, ply), depth, bound, has_best_move ? &best_move : nullptr);
         return value;
 	}
 
-	std::string search(Position* position, int depth){
-		double infinity = 10000000;
-		std::string bestMove = "";
+	/*
+	* Searches the root moves in order within the window, raising alpha as
+	* better moves are found. root_best is only replaced by a move scoring
+	* above the initial alpha, so it is kept when the whole root fails low.
+	* Once the search is stopped the scores are meaningless : the move
+	* being searched is dropped and the loop ends.
+	*/
+	double SearchThread::search_root(MoveList& moves, double alpha, double beta, int depth, Move& root_best){
+		double value = -INFINITE_VALUE;
+		for(int i = 0; i < moves.size(); i++){
+			Move m = moves[i];
+			StateInfo st;
+			position.make_move(&m, st);
+			double score = search_child(alpha, beta, depth, 0, i == 0);
+			position.unmake_move(m, st);
+			if(stopped){
+				break;
+			}
+			if(score > value){
+				value = score;
+				if(score > alpha){
+					root_best = m;
+				}
+			}
+			alpha = std::max(value, alpha);
+			if(alpha >= beta){
+				break;
+			}
+		}
+		return value;
+	}
 
-		double value = -infinity;
+	/*
+	* Iterative deepening : searches the root to depth 1, 2, 3... trying
+	* the best move of the previous iteration first, until a limit is hit.
+	* Helpers keep their own root order, and never fall behind the depth
+	* of the main thread (plus one for odd helpers).
+	* The move of the last completed iteration is kept, unless depth 1 is
+	* cut short, in which case the best of the root moves fully searched
+	* before the stop is played. From ASPIRATION_DEPTH on, each iteration
+	* starts with a narrow window around the previous score, widened on
+	* the failing side until the score falls inside.
+	*/
+	void SearchThread::iterate(){
+		MoveGenerator generator(&position);
+		generator.generate();
+		if(id > 0){
+			std::rotate(generator.moveList.begin(), generator.moveList.begin() + id % generator.moveList.size(),
+				generator.moveList.end());
+		}
+		best_move = generator.moveList[0];
+		int max_depth = limits.depth ? std::min(limits.depth, MAX_PLY) : MAX_PLY;
+		// helpers one ply deeper may go one ply beyond the depth limit
+		int depth_offset = id & 1;
+		max_depth = std::min(max_depth + depth_offset, MAX_PLY);
+		double previous_value = 0;
+		int completed_depth = 0;
+		int depth = 0;
+
+		while(true){
+			depth = id == 0 ? depth + 1 : std::max(depth + 1, main_depth.load(std::memory_order_relaxed) + depth_offset);
+			if(depth > max_depth){
+				break;
+			}
+			if(id == 0){
+				main_depth.store(depth, std::memory_order_relaxed);
+			}
+			double alpha = -INFINITE_VALUE;
+			double beta = INFINITE_VALUE;
+			double delta = ASPIRATION_DELTA;
+			if(depth >= ASPIRATION_DEPTH && completed_depth > 0){
+				alpha = previous_value - delta;
+				beta = previous_value + delta;
+			}
+
+			double value;
+			Move iteration_best = best_move;
+			while(true){
+				if(id == 0){
+					for(Move& m : generator.moveList){
+						if(m == iteration_best){
+							std::swap(m, generator.moveList[0]);
+							break;
+						}
+					}
+				}
+				value = search_root(generator.moveList, alpha, beta, depth, iteration_best);
+				if(stopped){
+					break;
+				}
+				if(value <= alpha){
+					alpha = std::max(alpha - delta, -INFINITE_VALUE);
+				} else if(value >= beta){
+					beta = std::min(beta + delta, INFINITE_VALUE);
+				} else {
+					break;
+				}
+				delta *= 2;
+			}
+			if(stopped){
+				// a cut short depth 1 still beats the unsearched first move
+				if(depth == 1){
+					best_move = iteration_best;
+				}
+				break;
+			}
+			best_move = iteration_best;
+			previous_value = value;
+			completed_depth = depth;
+			if(id > 0){
+				continue;
+			}
+
+			int elapsed = time_manager.elapsed();
+			if(print_info){
+				// one write per line, the input thread may be printing too
+				U64 nodes = total_nodes();
+				std::stringstream info;
+				info << "info depth " << depth << " score " << uci_score(value)
+					 << " nodes " << nodes << " nps " << nodes * 1000 / (elapsed + 1)
+					 << " time " << elapsed << " pv " << best_move.to_long_algebraic() << "\n";
+				std::cout << info.str() << std::flush;
+			}
+			// the next iteration would most likely not finish in time
+			if(!pondering && time_manager.optimum() && elapsed >= time_manager.optimum() / 2){
+				break;
+			}
+		}
+	}
 
-        MoveGenerator generator(position);
+	// UCI forbids a bestmove before stop or ponderhit in infinite and ponder modes
+	void wait_for_stop(){
+		while((limits.infinite || pondering) && !stopped){
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		stopped = true;
+	}
+
+	std::string search(Position* position, const SearchLimits& search_limits, int threads, bool verbose){
+		limits = search_limits;
+		print_info = verbose;
+		time_manager.init(limits, position->get_turn());
+		nodes = 0;
+		tt.new_search();
+		main_depth = 1;
+
+		MoveGenerator generator(position);
 		generator.generate();
-        for(Move m : generator.moveList){
-        	Position new_position(*position);
-        	new_position.make_move(&m);
-        	
-    		double score = -alphabeta(-infinity, infinity, &new_position, depth - 1);// * (position->get_turn() == Position::WHITE ? 1 : -1);
-    		if(score >= value){
-    			value = score;
-    			bestMove = m.to_long_algebraic();
-    		}
-    		//std::cout << m.to_long_algebraic() << " " << score << std::endl; 
-        }
-		return bestMove;
+		if(generator.moveList.empty()){
+			wait_for_stop();
+			return "0000";
+		}
+
+		std::vector<std::unique_ptr<SearchThread>> workers;
+		for(int i = 0; i < std::max(1, threads); i++){
+			workers.emplace_back(new SearchThread(i, *position));
+			search_threads.push_back(workers.back().get());
+		}
+		std::vector<std::thread> helpers;
+		for(size_t i = 1; i < workers.size(); i++){
+			helpers.emplace_back(&SearchThread::iterate, workers[i].get());
+		}
+		workers[0]->iterate();
+
+		wait_for_stop();
+		for(std::thread& helper : helpers){
+			helper.join();
+		}
+		nodes = total_nodes();
+		search_threads.clear();
+		return workers[0]->best_move.to_long_algebraic();
+	}
+
+	std::string search(Position* position, int depth){
+		SearchLimits fixed_depth;
+		fixed_depth.depth = depth;
+		init_search(false);
+		return search(position, fixed_depth, 1, false);
 	}
 
-}
\ No newline at end of file
+}
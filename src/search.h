@@ -1,13 +1,44 @@
 #ifndef SEARCH_H_INCLUDED
 #define SEARCH_H_INCLUDED
 
+#include <string>
+
 #include "position.h"
 
 namespace chess{
+
+	const int MAX_PLY = 64;
+
+	/*
+	* Limits of a search as given by the UCI go command. Times are in
+	* milliseconds, 0 meaning not set.
+	*/
+	struct SearchLimits{
+		int wtime = 0;
+		int btime = 0;
+		int winc = 0;
+		int binc = 0;
+		int movestogo = 0;
+		int movetime = 0;
+		int depth = 0;
+		U64 nodes = 0;
+		bool infinite = false;
+		bool ponder = false;
+	};
+
+	/*
+	* The stop and ponder flags may be set from another thread while the
+	* search runs. init_search resets them and must be called before the
+	* search is started, so that an early stop or ponderhit is not lost.
+	*/
+	void init_search(bool ponder);
+	void stop_search();
+	void ponderhit();
+
 	double eval(Position* position);
-	double alphabetaMax(double alpha, double beta, Position* position, int depth);
-	double alphabetaMin(double alpha, double beta, Position* position, int depth);
+	std::string search(Position* position, const SearchLimits& limits, int threads, bool verbose = true);
 	std::string search(Position* position, int depth);
+	U64 searched_nodes();
 }
 
 #endif // #ifndef SEARCH_H_INCLUDED
@@ -0,0 +1,40 @@
+#include <algorithm>
+
+#include "timeman.h"
+
+namespace chess {
+
+    // std::min binds its arguments by reference, the constants need a definition
+    const int TimeManager::MOVE_OVERHEAD;
+    const int TimeManager::DEFAULT_MOVES_TO_GO;
+
+    void TimeManager::init(const SearchLimits& limits, Color us){
+        start = std::chrono::steady_clock::now();
+        optimum_time = 0;
+        maximum_time = 0;
+
+        if(limits.infinite){
+            return;
+        }
+        if(limits.movetime){
+            optimum_time = maximum_time = std::max(1, limits.movetime - MOVE_OVERHEAD);
+            return;
+        }
+        int time = us == Position::WHITE ? limits.wtime : limits.btime;
+        int inc = us == Position::WHITE ? limits.winc : limits.binc;
+        if(!time){
+            return;
+        }
+        int moves_to_go = limits.movestogo ? std::min(limits.movestogo, DEFAULT_MOVES_TO_GO) : DEFAULT_MOVES_TO_GO;
+        // never plan to use more than what is left on the clock
+        int available = std::max(1, time - MOVE_OVERHEAD);
+        optimum_time = std::min(available, time / moves_to_go + inc * 3 / 4);
+        maximum_time = std::min(available, std::max(optimum_time, std::min(optimum_time * 5, time / 4)));
+    }
+
+    int TimeManager::elapsed() const {
+        return int(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+
+}
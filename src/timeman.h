@@ -0,0 +1,34 @@
+#ifndef TIMEMAN_H_INCLUDED
+#define TIMEMAN_H_INCLUDED
+
+#include <chrono>
+
+#include "search.h"
+
+namespace chess {
+
+    /*
+    * Splits the remaining clock into an optimum time, after which no new
+    * iteration is started, and a maximum time, at which the search is
+    * stopped wherever it is. Times are in milliseconds since the search
+    * started; both are 0 when the search is not limited by time.
+    */
+    class TimeManager{
+    public:
+        static const int MOVE_OVERHEAD = 30;
+        static const int DEFAULT_MOVES_TO_GO = 30;
+
+        void init(const SearchLimits& limits, Color us);
+        int elapsed() const;
+        int optimum() const { return optimum_time; }
+        int maximum() const { return maximum_time; }
+
+    private:
+        std::chrono::steady_clock::time_point start;
+        int optimum_time;
+        int maximum_time;
+    };
+
+}
+
+#endif // #ifndef TIMEMAN_H_INCLUDED
@@ -0,0 +1,138 @@
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+#include "tt.h"
+
+namespace chess {
+
+    TranspositionTable tt;
+
+    U64 pack_move(Move* move){
+        if(!move){
+            return 0;
+        }
+        return U64(move->get_from_layer())
+             | U64(move->get_from_square()) << 4
+             | U64(move->get_to_layer()) << 10
+             | U64(move->get_to_square()) << 14;
+    }
+
+    U64 pack_score(double score){
+        float f = float(score);
+        uint32_t bits;
+        std::memcpy(&bits, &f, sizeof(bits));
+        return bits;
+    }
+
+    double unpack_score(U64 data){
+        uint32_t bits = uint32_t(data >> 20);
+        float f;
+        std::memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+
+    void TranspositionTable::resize(size_t mb){
+        size_mb = mb;
+        count = 0;
+        if(mb > 0){
+            // round down to a power of two number of buckets
+            count = 1;
+            // saturate instead of overflowing on absurd sizes
+            size_t bytes = mb > (SIZE_MAX >> 20) ? SIZE_MAX : mb << 20;
+            while(count <= bytes / (2 * sizeof(Bucket))){
+                count *= 2;
+            }
+        }
+        // new[] does not honour the cache line alignment before C++17
+        // free the old table first, and settle for a smaller one if memory runs out
+        memory.reset();
+        while(count && !(memory.reset(new (std::nothrow) char[count * sizeof(Bucket) + alignof(Bucket) - 1]), memory)){
+            count /= 2;
+        }
+        buckets = nullptr;
+        if(count){
+            uintptr_t address = reinterpret_cast<uintptr_t>(memory.get());
+            buckets = reinterpret_cast<Bucket*>((address + alignof(Bucket) - 1) & ~uintptr_t(alignof(Bucket) - 1));
+            for(size_t i = 0; i < count; i++){
+                new (&buckets[i]) Bucket();
+            }
+        }
+        clear();
+    }
+
+    void TranspositionTable::clear(){
+        for(size_t i = 0; i < count; i++){
+            for(Entry& e : buckets[i].entries){
+                e.key.store(0, std::memory_order_relaxed);
+                e.data.store(0, std::memory_order_relaxed);
+            }
+        }
+        age = 0;
+    }
+
+    void TranspositionTable::new_search(){
+        age = (age + 1) & 7;
+    }
+
+    bool TranspositionTable::probe(U64 key, TTEntry& entry){
+        if(!count){
+            return false;
+        }
+        Bucket& bucket = buckets[key & (count - 1)];
+        for(Entry& e : bucket.entries){
+            U64 data = e.data.load(std::memory_order_relaxed);
+            if((e.key.load(std::memory_order_relaxed) ^ data) != key || !data){
+                continue;
+            }
+            U64 move = data & 0xFFFFF;
+            entry.score = unpack_score(data);
+            entry.depth = int(data >> 52 & 0x7F);
+            entry.bound = Bound(data >> 59 & 0x3);
+            entry.has_move = move != 0;
+            entry.move.set(move & 0xF, move >> 4 & 0x3F, move >> 10 & 0xF, move >> 14 & 0x3F);
+            // keep entries still in use from ageing out
+            if((data >> 61) != age){
+                data = (data & ~(U64(0x7) << 61)) | U64(age) << 61;
+                e.key.store(key ^ data, std::memory_order_relaxed);
+                e.data.store(data, std::memory_order_relaxed);
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void TranspositionTable::store(U64 key, double score, int depth, Bound bound, Move* move){
+        if(!count){
+            return;
+        }
+        if(depth > MAX_DEPTH){
+            depth = MAX_DEPTH;
+        }
+        U64 fields = pack_score(score) << 20 | U64(depth) << 52 | U64(bound) << 59 | U64(age) << 61;
+        Bucket& bucket = buckets[key & (count - 1)];
+        Entry* replace = &bucket.entries[0];
+        U64 move_bits = pack_move(move);
+        int replace_value = 1 << 30;
+        for(Entry& e : bucket.entries){
+            U64 data = e.data.load(std::memory_order_relaxed);
+            if((e.key.load(std::memory_order_relaxed) ^ data) == key && data){
+                // a fail low knows no best move, keep the previous one
+                if(!move){
+                    move_bits = data & 0xFFFFF;
+                }
+                replace = &e;
+                break;
+            }
+            int value = int(data >> 52 & 0x7F) - 8 * ((age - int(data >> 61)) & 7);
+            if(value < replace_value){
+                replace_value = value;
+                replace = &e;
+            }
+        }
+        U64 data = move_bits | fields;
+        replace->key.store(key ^ data, std::memory_order_relaxed);
+        replace->data.store(data, std::memory_order_relaxed);
+    }
+
+}
@@ -0,0 +1,77 @@
+#ifndef TT_H_INCLUDED
+#define TT_H_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+#include "move.h"
+#include "utils.h"
+
+namespace chess {
+
+    enum Bound : U8 {
+        BOUND_NONE  = 0,
+        BOUND_UPPER = 1,
+        BOUND_LOWER = 2,
+        BOUND_EXACT = BOUND_UPPER | BOUND_LOWER
+    };
+
+    /*
+    * What the search learnt about a position : the score, whether it is
+    * exact or only a bound, the depth it was searched to and the best move
+    * found (has_move is false when the node failed low).
+    */
+    struct TTEntry{
+        double score;
+        int depth;
+        Bound bound;
+        bool has_move;
+        Move move;
+    };
+
+    /*
+    * Transposition table of the alpha-beta search. Buckets are one cache
+    * line of four entries, so a probe costs a single memory access.
+    *
+    * An entry packs the move, score, depth, bound and search generation
+    * (age) in one 64-bit word stored next to key ^ data, the same lockless
+    * scheme as the perft table. On store a bucket first reuses the slot of
+    * the same position, then replaces the entry with the lowest depth,
+    * entries left by older searches counting as shallower.
+    */
+    class TranspositionTable{
+    public:
+        static const int MAX_DEPTH = 127;
+
+        void resize(size_t mb);
+        size_t size() const { return size_mb; }
+        void clear();
+        void new_search();
+        bool probe(U64 key, TTEntry& entry);
+        void store(U64 key, double score, int depth, Bound bound, Move* move);
+
+    private:
+        static const int BUCKET_SIZE = 4;
+
+        struct Entry{
+            std::atomic<U64> key;  // key ^ data
+            std::atomic<U64> data; // move | score << 20 | depth << 52 | bound << 59 | age << 61
+        };
+
+        struct alignas(64) Bucket{
+            Entry entries[BUCKET_SIZE];
+        };
+
+        std::unique_ptr<char[]> memory;
+        Bucket* buckets = nullptr;
+        size_t count = 0;
+        size_t size_mb = 0; // as requested, the table may be smaller if memory ran out
+        U8 age = 0;
+    };
+
+    extern TranspositionTable tt;
+
+}
+
+#endif // #ifndef TT_H_INCLUDED
@@ -1,11 +1,15 @@
 #include <algorithm>
 #include <cctype>
 #include <chrono>
+#include <climits>
 #include <iostream>
 #include <sstream>
 
-#include "uci.h"
+#include "bench.h"
+#include "perft.h"
 #include "search.h"
+#include "tt.h"
+#include "uci.h"
 
 /*
 Implementing the protocol defined at
@@ -44,8 +48,46 @@ namespace uci {
 
 
 
+    // ranges of the spin options, as advertised by the uci command
+    const int HASH_DEFAULT = 16;
+    const int HASH_MIN = 1;
+    const int HASH_MAX = 65536;
+    const int THREADS_DEFAULT = 1;
+    const int THREADS_MIN = 1;
+    const int THREADS_MAX = 512;
+    const int PERFT_HASH_DEFAULT = 16;
+    const int PERFT_HASH_MIN = 0;
+    const int PERFT_HASH_MAX = 65536;
+
+    // parses an integer clamped to [min, max], false and result untouched if it is not a number
+    bool parse_number(const std::string &value, long long min, long long max, long long &result){
+        long long number;
+        size_t end;
+        try {
+            number = std::stoll(value, &end);
+        } catch(const std::exception &e) {
+            return false;
+        }
+        if(end != value.size()){
+            return false;
+        }
+        result = std::max(min, std::min(max, number));
+        return true;
+    }
+
+    bool parse_spin(const std::string &value, int min, int max, int &result){
+        long long number;
+        if(!parse_number(value, min, max, number)){
+            return false;
+        }
+        result = int(number);
+        return true;
+    }
+
     void UCIEngine::run(){
         position = new chess::Position();
+        perft_table.resize(PERFT_HASH_DEFAULT);
+        chess::tt.resize(HASH_DEFAULT);
         std::string line;
         while(getline(std::cin, line)){
             line = remove_duplicate_whitespaces(line);
@@ -71,6 +113,7 @@ namespace uci {
             else if(cmd == "quit") { uci_quit(params); }
 
             // Proprietary extensions
+            else if(cmd == "bench") { bench(params); }
             else if(cmd == "display") { display(params); }
             else if(cmd == "eval") { eval(params); }
             else if(cmd == "fen") { fen(params); }
@@ -80,11 +123,19 @@ namespace uci {
             // default
             else { std::cout << "unknonwn command: " << cmd << std::endl; }
         }
+        chess::stop_search();
+        wait_for_search();
     }
 
     void UCIEngine::uci(const std::string &params){
         std::cout << "id name Myfish" << std::endl;
         std::cout << "id author Julien Durand" << std::endl;
+        std::cout << "option name Hash type spin default " << HASH_DEFAULT
+                  << " min " << HASH_MIN << " max " << HASH_MAX << std::endl;
+        std::cout << "option name Threads type spin default " << THREADS_DEFAULT
+                  << " min " << THREADS_MIN << " max " << THREADS_MAX << std::endl;
+        std::cout << "option name PerftHash type spin default " << PERFT_HASH_DEFAULT
+                  << " min " << PERFT_HASH_MIN << " max " << PERFT_HASH_MAX << std::endl;
         std::cout << "uciok" << std::endl;
     }
 
@@ -99,11 +150,32 @@ namespace uci {
     }
 
     void UCIEngine::uci_isready(const std::string &params){
-        std::cout << "readyok" << std::endl;
+        std::cout << "readyok\n" << std::flush;
     }
 
     void UCIEngine::uci_setoption(const std::string &params){
-        /*unimplemented*/
+        std::stringstream ss = std::stringstream(params);
+        std::string token;
+        std::string name;
+        std::string value;
+        getline(ss, token, ' '); // setoption
+        getline(ss, token, ' '); // name
+        while(getline(ss, token, ' ') && token != "value"){
+            name += (name.empty() ? "" : " ") + token;
+        }
+        while(getline(ss, token, ' ')){
+            value += (value.empty() ? "" : " ") + token;
+        }
+        // options are not changed under a running search
+        chess::stop_search();
+        wait_for_search();
+
+        int number;
+        if(name == "Hash" && parse_spin(value, HASH_MIN, HASH_MAX, number)) { chess::tt.resize(number); }
+        else if(name == "Threads" && parse_spin(value, THREADS_MIN, THREADS_MAX, number)) { threads = number; }
+        else if(name == "PerftHash" && parse_spin(value, PERFT_HASH_MIN, PERFT_HASH_MAX, number)) { perft_table.resize(number); }
+        else if(name == "Hash" || name == "Threads" || name == "PerftHash") { std::cout << "invalid value: " << value << std::endl; }
+        else { std::cout << "unknown option: " << name << std::endl; }
     }
 
     void UCIEngine::uci_register(const std::string &params){
@@ -111,7 +183,10 @@ namespace uci {
     }
 
     void UCIEngine::uci_newgame(const std::string &params){
+        chess::stop_search();
+        wait_for_search();
         position->reset();
+        chess::tt.clear();
     }
 
     void UCIEngine::uci_position(const std::string &params){
@@ -140,22 +215,74 @@ namespace uci {
     }
 
     void UCIEngine::uci_go(const std::string &params){
-        auto move = chess::search(position, 6);
-        std::cout << "bestmove " <<  move + "\n";;
+        std::stringstream ss = std::stringstream(params);
+        std::string param;
+        chess::SearchLimits limits;
+        long long nodes;
+        // malformed values are ignored, the limit keeps its default
+        getline(ss, param, ' '); // go
+        while(getline(ss, param, ' ')){
+            std::string value;
+            if(param == "infinite") { limits.infinite = true; }
+            else if(param == "ponder") { limits.ponder = true; }
+            else if(param == "wtime" && getline(ss, value, ' ')) { parse_spin(value, 0, INT_MAX, limits.wtime); }
+            else if(param == "btime" && getline(ss, value, ' ')) { parse_spin(value, 0, INT_MAX, limits.btime); }
+            else if(param == "winc" && getline(ss, value, ' ')) { parse_spin(value, 0, INT_MAX, limits.winc); }
+            else if(param == "binc" && getline(ss, value, ' ')) { parse_spin(value, 0, INT_MAX, limits.binc); }
+            else if(param == "movestogo" && getline(ss, value, ' ')) { parse_spin(value, 0, INT_MAX, limits.movestogo); }
+            else if(param == "movetime" && getline(ss, value, ' ')) { parse_spin(value, 0, INT_MAX, limits.movetime); }
+            else if(param == "depth" && getline(ss, value, ' ')) { parse_spin(value, 0, INT_MAX, limits.depth); }
+            else if(param == "nodes" && getline(ss, value, ' ') && parse_number(value, 0, LLONG_MAX, nodes)) { limits.nodes = nodes; }
+        }
+
+        // a new go implicitly stops the previous search
+        chess::stop_search();
+        wait_for_search();
+
+        // the search runs on its own copy, the input loop keeps the position
+        search_position = *position;
+        chess::init_search(limits.ponder);
+        search_thread = std::thread([this, limits](){
+            std::string move = chess::search(&search_position, limits, threads);
+            std::cout << "bestmove " + move + "\n" << std::flush;
+        });
     }
 
     void UCIEngine::uci_stop(const std::string &params){
-        /*unimplemented*/
+        chess::stop_search();
+        wait_for_search();
     }
 
     void UCIEngine::uci_ponderhit(const std::string &params){
-        /*unimplemented*/
+        chess::ponderhit();
     }
 
     void UCIEngine::uci_quit(const std::string &params){
+        chess::stop_search();
+        wait_for_search();
         exit(0);
     }
 
+    // blocks until the running search, if any, has sent its bestmove : stop an infinite or ponder search first
+    void UCIEngine::wait_for_search(){
+        if(search_thread.joinable()){
+            search_thread.join();
+        }
+    }
+
+    void UCIEngine::bench(const std::string &params){
+        chess::stop_search();
+        wait_for_search();
+        std::stringstream ss = std::stringstream(params);
+        std::string param;
+        getline(ss, param, ' ');
+        int depth = chess::BENCH_SEARCH_DEPTH;
+        if(getline(ss, param, ' ')){
+            depth = std::stoi(param);
+        }
+        chess::bench(depth);
+    }
+
     void UCIEngine::display(const std::string &params){
         const std::string rank_separator = "+---+---+---+---+---+---+---+---+";
         const std::string file_separator = "|";
@@ -180,6 +307,9 @@ namespace uci {
             std::to_string(position->get_reversible_plies()) + "\n";
         sb += "Moves: " + std::to_string(position->get_move()) + "\n";
         sb += "Plies: " + std::to_string(position->get_plies()) + "\n";
+        std::stringstream key;
+        key << std::hex << std::uppercase << position->key();
+        sb += "Key: " + key.str() + "\n";
         std::cout << sb;
     }
 
@@ -212,8 +342,9 @@ namespace uci {
         getline(ss, param, ' ');
         int depth = std::stoi(param);
 
+        perft_table.clear();
         auto start = std::chrono::steady_clock::now();
-        int nodes = chess::perft(depth, position, true);
+        chess::U64 nodes = chess::parallel_perft(depth, position, true, &perft_table, threads);
         auto end = std::chrono::steady_clock::now();
         float duration = float(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()) / 1000000;
         std::cout << std::endl << "Searched " << nodes <<  " nodes in " << duration << "s (" << float(nodes) / 1000 / duration << " kNodes/s)." << std::endl << std::endl;
@@ -2,8 +2,10 @@
 #define UCI_H_INCLUDED
 
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "perft.h"
 #include "position.h"
 
 namespace uci {
@@ -12,6 +14,10 @@ namespace uci {
 
     bool debug = false;
     chess::Position* position;
+    chess::PerftTable perft_table;
+    int threads = 1;
+    chess::Position search_position;
+    std::thread search_thread;
 
     public:
         void run();
@@ -28,8 +34,10 @@ namespace uci {
         void uci_stop(const std::string &params);
         void uci_ponderhit(const std::string &params);
         void uci_quit(const std::string &params);
+        void wait_for_search();
 
         // Proprietary extensions
+        void bench(const std::string &params);
         void display(const std::string &params);
         void eval(const std::string &params);
         void fen(const std::string &params);
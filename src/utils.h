@@ -1,6 +1,8 @@
 #ifndef UTILS_H_INCLUDED
 #define UTILS_H_INCLUDED
 
+#include <cstdint>
+
 namespace chess {
 
     typedef uint64_t U64;
@@ -13,6 +15,30 @@ namespace chess {
     class Move;
     class MoveGenerator;
 
+    /*
+    * xorshift64* pseudo random generator, seeded with fixed values so that
+    * magics and hash keys are the same from one run to the next.
+    */
+    class PRNG {
+    private:
+        U64 s;
+
+    public:
+        PRNG(U64 seed) : s(seed) {}
+
+        U64 rand(){
+            s ^= s >> 12;
+            s ^= s << 25;
+            s ^= s >> 27;
+            return s * 2685821657736338717ULL;
+        }
+
+        // candidates with few bits set make better magics
+        U64 sparse_rand(){
+            return rand() & rand() & rand();
+        }
+    };
+
 }
 
 #endif // #ifndef UTILS_H_INCLUDED
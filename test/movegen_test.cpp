@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bitboard.h"
+#include "perft.h"
+#include "position.h"
+#include "scheduler.h"
+
+/*
+Move generation test runner : checks perft node counts of the positions in
+test/movegen_tests.json and of a built-in suite, all in-process and in
+parallel on the work-stealing scheduler, then the static exchange
+evaluation of a few captures.
+
+Usage : myfish_test [movegen_tests.json]
+*/
+
+struct TestCase{
+    std::string fen;
+    int depth;
+    chess::U64 nodes;
+    chess::U64 result;
+    double duration;
+};
+
+const TestCase BUILTIN_TESTS[] = {
+    {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 6, 119060324},
+    {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 5, 193690690},
+    {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 6, 11030083},
+    {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 5, 15833292},
+    {"r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1", 5, 15833292},
+    {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 5, 89941194},
+    {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 5, 164075551},
+    {"n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1", 5, 3605103},
+    {"8/PPP4k/8/8/8/8/4Kppp/8 w - - 0 1", 6, 34336777},
+    {"r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1", 5, 7594526},
+    {"4k3/8/8/8/8/8/8/4K2R w K - 0 1", 6, 764643},
+    {"8/8/8/3k4/3Pp3/8/8/3K4 b - d3 0 1", 6, 75854},
+};
+
+struct SeeTest{
+    std::string fen;
+    std::string move;
+    int see;
+};
+
+// expected exchange results in pawns, see_ge is checked on both sides of each
+const SeeTest SEE_TESTS[] = {
+    // x-ray : the second rook recaptures through the first one
+    {"3rk3/8/8/3p4/8/8/3R4/3RK3 w - - 0 1", "d2d5", 1},
+    {"3rk3/8/8/3p4/8/8/3R4/3QK3 w - - 0 1", "d2d5", 1},
+    {"3rk3/8/8/3p4/8/8/3Q4/3RK3 w - - 0 1", "d2d5", -3},
+    {"1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w - - 0 1", "d3e5", -2},
+    // en passant : the captured pawn no longer blocks the rook behind it
+    {"4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1", "e5d6", 1},
+    {"4k3/8/8/3pP3/8/8/3r4/7K w - d6 0 1", "e5d6", 0},
+    // promotions
+    {"1r2k3/P7/8/8/8/8/8/4K3 w - - 0 1", "a7b8q", 13},
+    {"1rk5/P7/8/8/8/8/8/4K3 w - - 0 1", "a7b8q", 4},
+    {"r3k3/1P6/8/8/8/8/8/4K3 w - - 0 1", "b7b8q", -1},
+};
+
+/*
+* Reads the flat array of {"depth", "nodes", "fen"} objects of
+* movegen_tests.json. Not a general JSON parser.
+*/
+bool load_tests(const std::string &path, std::vector<TestCase> &tests){
+    std::ifstream file(path);
+    if(!file){
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string json = buffer.str();
+
+    size_t pos = 0;
+    while((pos = json.find('{', pos)) != std::string::npos){
+        size_t end = json.find('}', pos);
+        std::string object = json.substr(pos, end - pos);
+        TestCase test = {"", 0, 0, 0, 0};
+        size_t key = 0;
+        while((key = object.find('"', key)) != std::string::npos){
+            size_t key_end = object.find('"', key + 1);
+            std::string name = object.substr(key + 1, key_end - key - 1);
+            size_t value = object.find_first_not_of(" \t\r\n:", key_end + 1);
+            if(object[value] == '"'){
+                size_t value_end = object.find('"', value + 1);
+                if(name == "fen"){
+                    test.fen = object.substr(value + 1, value_end - value - 1);
+                }
+                key = value_end + 1;
+            } else {
+                size_t value_end = object.find_first_of(",\r\n", value);
+                std::string number = object.substr(value, value_end - value);
+                if(name == "depth"){
+                    test.depth = std::stoi(number);
+                } else if(name == "nodes"){
+                    test.nodes = std::stoull(number);
+                }
+                key = value_end;
+            }
+        }
+        tests.push_back(test);
+        pos = end;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]){
+    chess::init_bitboards();
+    chess::Position::init();
+
+    std::string path = argc > 1 ? argv[1] : "test/movegen_tests.json";
+    std::vector<TestCase> tests;
+    if(!load_tests(path, tests)){
+        std::cout << "cannot read " << path << std::endl;
+        return 1;
+    }
+    for(const TestCase& test : BUILTIN_TESTS){
+        tests.push_back(test);
+    }
+
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    auto start = std::chrono::steady_clock::now();
+    {
+        chess::TaskScheduler scheduler(threads);
+        for(TestCase& test : tests){
+            TestCase* t = &test;
+            scheduler.spawn([t](){
+                auto test_start = std::chrono::steady_clock::now();
+                chess::Position position;
+                position.import_fen(t->fen);
+                t->result = chess::perft(t->depth, &position, false);
+                auto test_end = std::chrono::steady_clock::now();
+                t->duration = std::chrono::duration_cast<std::chrono::microseconds>(test_end - test_start).count() / 1000000.0;
+            });
+        }
+        scheduler.wait();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+    int failures = 0;
+    chess::U64 nodes = 0;
+    for(const TestCase& test : tests){
+        bool success = test.result == test.nodes;
+        failures += !success;
+        nodes += test.result;
+        std::cout << (success ? "OK" : "FAILED") << " : " << test.fen << " " << test.depth << " "
+                  << test.result;
+        if(!success){
+            std::cout << " (expected " << test.nodes << ")";
+        }
+        std::cout << " [" << test.duration << "s]" << std::endl;
+    }
+    std::cout << std::endl << tests.size() - failures << "/" << tests.size() << " passed, "
+              << nodes << " nodes in " << duration << "s on " << threads << " threads ("
+              << chess::U64(nodes / duration / 1000) << " kNodes/s)." << std::endl << std::endl;
+
+    int see_failures = 0;
+    for(const SeeTest& test : SEE_TESTS){
+        chess::Position position;
+        position.import_fen(test.fen);
+        chess::Move move = position.get_move_from_long_algebraic(test.move);
+        int see = position.see(move);
+        bool success = see == test.see && position.see_ge(move, test.see) && !position.see_ge(move, test.see + 1);
+        see_failures += !success;
+        std::cout << (success ? "OK" : "FAILED") << " : see " << test.fen << " " << test.move << " " << see;
+        if(!success){
+            std::cout << " (expected " << test.see << ")";
+        }
+        std::cout << std::endl;
+    }
+    int see_count = sizeof(SEE_TESTS) / sizeof(SEE_TESTS[0]);
+    std::cout << std::endl << see_count - see_failures << "/" << see_count << " see tests passed." << std::endl;
+    return failures || see_failures ? 1 : 0;
+}
@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "bitboard.h"
+#include "move.h"
+#include "perft.h"
+#include "position.h"
+#include "scheduler.h"
+#include "qperft.h"
+
+/*
+Differential perft : plays random games from a few seed positions and
+compares the perft counts of myfish and of the reference qperft generator
+on every position reached. A mismatch is shrunk move by move down to the
+position where the legal move lists differ.
+
+Usage : myfish_perftdiff [positions] [depth] [threads] [seed]
+*/
+
+const char* SEED_POSITIONS[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1",
+};
+
+const int MAX_RANDOM_PLIES = 120;
+const int POSITIONS_PER_TASK = 256;
+
+std::mutex output_mutex;
+std::atomic<long> checked(0);
+std::atomic<long> skipped(0);
+std::atomic<long> mismatches(0);
+
+chess::U64 perft_nodes(int depth, chess::Position* position){
+    return depth == 0 ? 1 : chess::perft(depth, position, false);
+}
+
+/*
+* Walks down the first root move whose subtree counts differ until the node
+* where every child agrees but the totals do not : there the move lists
+* themselves differ. The moves played on the way are appended to path.
+*/
+std::string shrink(chess::Position* position, int depth, std::string& path){
+    chess::MoveGenerator generator(position);
+    generator.generate();
+    chess::U64 total = 0;
+    for(chess::Move m : generator.moveList){
+        chess::StateInfo st;
+        position->make_move(&m, st);
+        chess::U64 ours = perft_nodes(depth - 1, position);
+        long long theirs = qperft(position->export_fen().c_str(), depth - 1);
+        if(ours != chess::U64(theirs)){
+            path += m.to_long_algebraic() + " ";
+            std::string report = shrink(position, depth - 1, path);
+            position->unmake_move(m, st);
+            return report;
+        }
+        position->unmake_move(m, st);
+        total += ours;
+    }
+    std::string moves;
+    for(chess::Move m : generator.moveList){
+        moves += m.to_long_algebraic() + " ";
+    }
+    return position->export_fen() + " : myfish " + std::to_string(generator.moveList.size())
+         + " moves, qperft " + std::to_string(qperft(position->export_fen().c_str(), 1))
+         + " (" + moves + ")";
+}
+
+void check_position(chess::Position* position, int depth){
+    std::string fen = position->export_fen();
+    long long theirs = qperft(fen.c_str(), depth);
+    if(theirs < 0){
+        skipped++;
+        return;
+    }
+    checked++;
+    chess::U64 ours = perft_nodes(depth, position);
+    if(ours == chess::U64(theirs)){
+        return;
+    }
+    mismatches++;
+    std::string path;
+    std::string report = shrink(position, depth, path);
+    std::lock_guard<std::mutex> lock(output_mutex);
+    std::cout << "MISMATCH : " << fen << " depth " << depth << " myfish " << ours
+              << " qperft " << theirs << std::endl
+              << "  path : " << (path.empty() ? "(root)" : path) << std::endl
+              << "  at   : " << report << std::endl;
+}
+
+/*
+* Plays random legal games and checks each position they end on. Games are
+* reproducible from the seed.
+*/
+void check_random_positions(chess::U64 seed, int count, int depth){
+    chess::PRNG rng(seed);
+    int n_seeds = sizeof(SEED_POSITIONS) / sizeof(SEED_POSITIONS[0]);
+    for(int i = 0; i < count; i++){
+        chess::Position position;
+        position.import_fen(SEED_POSITIONS[rng.rand() % n_seeds]);
+        int plies = rng.rand() % MAX_RANDOM_PLIES;
+        for(int ply = 0; ply < plies; ply++){
+            chess::MoveGenerator generator(&position);
+            generator.generate();
+            if(generator.moveList.empty()){
+                break;
+            }
+            chess::StateInfo st;
+            position.make_move(&generator.moveList[rng.rand() % generator.moveList.size()], st);
+        }
+        check_position(&position, depth);
+    }
+}
+
+int main(int argc, char* argv[]){
+    long positions = argc > 1 ? std::stol(argv[1]) : 100000;
+    int depth = argc > 2 ? std::stoi(argv[2]) : 3;
+    int threads = argc > 3 ? std::stoi(argv[3]) : std::max(1u, std::thread::hardware_concurrency());
+    chess::U64 seed = argc > 4 ? std::stoull(argv[4]) : 1;
+
+    chess::init_bitboards();
+    chess::Position::init();
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        chess::TaskScheduler scheduler(threads);
+        for(long first = 0; first < positions; first += POSITIONS_PER_TASK){
+            int count = int(std::min<long>(POSITIONS_PER_TASK, positions - first));
+            chess::U64 task_seed = seed * 0x9E3779B97F4A7C15ULL + chess::U64(first) + 1;
+            scheduler.spawn([task_seed, count, depth](){
+                check_random_positions(task_seed, count, depth);
+            });
+        }
+        scheduler.wait();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000000.0;
+
+    std::cout << checked << " positions checked at depth " << depth << " (" << skipped
+              << " skipped), " << mismatches << " mismatches in " << duration << "s on "
+              << threads << " threads." << std::endl;
+    return mismatches ? 1 : 0;
+}
@@ -21,10 +21,15 @@ char *(names[MAXTIM])={"pintest", "contact", "castle", "ep-capt", "capture",
 #define TIME(A)
 #endif
 
+/* Global state is made per-thread when built as a library (test/qperft_lib.c) */
+#ifndef QPERFT_TLS
+#define QPERFT_TLS
+#endif
+
 /* Zobris key layout */
 #define Zobrist(A,B) (*(long long int *) (Zob[(A)-WHITE] + (B)))
 #define XSIZE (8*1024)
-union _bucket
+QPERFT_TLS union _bucket
 {
   struct { // one 32-byte entry
     unsigned long long int Signature1;
@@ -94,11 +99,12 @@ union _bucket
 #define capt_code  (brd+1+0xBC+0x77)      /* piece type that can reach this*/
 #define delta_vec  ((char *) brd+1+0xBC+0xEF+0x77) /* step to bridge certain vector */
 
-int rseed = 87105015;
-unsigned long long int accept[30], reject[30], miss[30];
-char *Zob[2*NPCE];
-unsigned char
-        pc[NPCE*4+1], /* piece list, equivalenced with various piece info  */
+QPERFT_TLS int rseed = 87105015;
+QPERFT_TLS unsigned long long int accept[30], reject[30], miss[30];
+QPERFT_TLS char *Zob[2*NPCE];
+QPERFT_TLS unsigned char
+        pc[NPCE*8],        /* piece list, equivalenced with various piece info, */
+                           /* padded as code[] is also read for guard squares */
         brd[0xBC+2*0xEF+1],      /* contains play bord and 2 delta boards  */
         CasRights,               /* one bit per castling, clear if allowed */
         HashFlag,
@@ -108,19 +114,19 @@ unsigned char
                    5, 3, 4, 6, 7, 4, 3, 5},
         capts[] = {0, C_PPAWN, C_MPAWN, C_KNIGHT, C_BISHOP,
                       C_ROOK, C_QUEEN, C_KING};
-char
+QPERFT_TLS char
         noUnder = 0,
         queen_dir[]   = {1, -1, 16, -16, 15, -15, 17, -17},
         king_rose[]   = {1,17,16,15,-1,-17,-16,-15},
         knight_rose[] = {18,33,31,14,-18,-33,-31,-14};
-char buf[80];
-
-char Keys[1040];
-int path[100];
-int stack[1024], msp, ep1, ep2, Kmoves, Promo, Split, epSqr, HashSize, HashSection;
-unsigned long long int HashKey=8729767686LL, HighKey=1234567890LL, count, epcnt, xcnt, ckcnt, cascnt, promcnt, nodecount; /* stats */
-FILE *f;
-clock_t ttt[30];
+QPERFT_TLS char buf[80];
+
+QPERFT_TLS char Keys[1040];
+QPERFT_TLS int path[100];
+QPERFT_TLS int stack[1024], msp, ep1, ep2, Kmoves, Promo, Split, epSqr, HashSize, HashSection;
+QPERFT_TLS unsigned long long int HashKey=8729767686LL, HighKey=1234567890LL, count, epcnt, xcnt, ckcnt, cascnt, promcnt, nodecount; /* stats */
+QPERFT_TLS FILE *f;
+QPERFT_TLS clock_t ttt[30];
 
 void board_init(char *b)
 { /* make an empty board surrounded by guard band of uncapturable pieces */
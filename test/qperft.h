@@ -0,0 +1,21 @@
+#ifndef QPERFT_H_INCLUDED
+#define QPERFT_H_INCLUDED
+
+/*
+Reference move generator : H.G. Muller's qperft (test/qperft.c) built as a
+library. Its global state is thread local, so it may be called from several
+threads at once.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* perft node count of the FEN position, or -1 if qperft cannot read it */
+long long qperft(const char *fen, int depth);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // #ifndef QPERFT_H_INCLUDED
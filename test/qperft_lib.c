@@ -0,0 +1,39 @@
+/*
+Builds test/qperft.c as a library : its globals become thread local and its
+main() is renamed out of the way.
+*/
+
+#include <string.h>
+
+#define QPERFT_TLS _Thread_local
+#define main qperft_main
+#include "qperft.c"
+#undef main
+
+#include "qperft.h"
+
+long long qperft(const char *fen, int depth)
+{
+    char copy[128];
+    int col, lastPly;
+
+    if(depth == 0) return 1;
+
+    strncpy(copy, fen, sizeof(copy) - 1);
+    copy[sizeof(copy) - 1] = 0;
+
+    msp = 0;
+    epSqr = 0;
+    count = 0;
+    delta_init();
+    piece_init();
+    board_init(board);
+    col = ReadFEN(copy);
+    if(col < 0) return -1;
+    setup();
+
+    lastPly = ((epSqr^16)<<24) + checker(col);
+    if(depth == 1) leaf_perft(col, lastPly, depth, 1);
+    else perft(col, lastPly, depth, 1);
+    return count;
+}